@@ -0,0 +1,9 @@
+g++ -O2 src/main.cpp ../ocam-undist/src/ocam-functions.cpp ../stitcher/src/stitch-functions.cpp ../common/src/raw-frames.cpp -o benchmark.out \
+    -I /usr/local/include/opencv4 \
+    -lopencv_core \
+    -lopencv_highgui \
+    -lopencv_imgproc \
+    -lopencv_imgcodecs \
+    -lopencv_calib3d
+
+./benchmark.out "$@"
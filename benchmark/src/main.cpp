@@ -0,0 +1,508 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <stdio.h>
+#include "../../ocam-undist/src/ocam-functions.h"
+#include "../../stitcher/src/stitch-functions.h"
+#include "../../common/src/raw-frames.h"
+
+struct BenchmarkSettings {
+  std::string ocamCalibFileName = "../example/undistortion/inputs/ocam-calib.txt";
+  std::string undistortionFileName = "../example/undistortion/inputs/input1.jpg";
+  float scaleFactor = 4.0;
+
+  int cameraNumber = 5;
+  std::vector<std::string> stitchFileNames = {
+    "../example/stitching/inputs/images/stitch1.jpg",
+    "../example/stitching/inputs/images/stitch2.jpg",
+    "../example/stitching/inputs/images/stitch3.jpg",
+    "../example/stitching/inputs/images/stitch4.jpg",
+    "../example/stitching/inputs/images/stitch5.jpg",
+  };
+  std::vector<std::string> intrinsicFileNames = {
+    "../example/stitching/inputs/camera-params/K1.txt",
+    "../example/stitching/inputs/camera-params/K2.txt",
+  };
+  std::vector<std::string> rotationFileNames = {
+    "../example/stitching/inputs/camera-params/R1.txt",
+    "../example/stitching/inputs/camera-params/R2.txt",
+    "../example/stitching/inputs/camera-params/R3.txt",
+    "../example/stitching/inputs/camera-params/R4.txt",
+    "../example/stitching/inputs/camera-params/R5.txt",
+    "../example/stitching/inputs/camera-params/R6.txt",
+    "../example/stitching/inputs/camera-params/R7.txt",
+    "../example/stitching/inputs/camera-params/R8.txt",
+  };
+
+  std::string calibrationFileNames = "../example/calibration/inputs/normal";
+  int firstCalibrationImageNr = 1;
+  int lastCalibrationImageNr = 5;
+  int horizontalCornerNr = 8;
+  int verticalCornerNr = 9;
+  float squareLength = 30.0;
+
+  // Number of frames undistorted end-to-end from JPEG files and from raw frame files
+  int rawFrameNumber = 16;
+
+  // Number of timed runs of every benchmark, after one untimed warm-up run
+  int iterations = 5;
+
+  // Results are written here as JSON
+  std::string outputFileName = "benchmark-results.json";
+
+  // When set, the results are compared against this saved JSON file
+  std::string baselineFileName = "";
+
+  // Allowed slowdown of the median time compared to the baseline, in percent
+  double threshold = 10.0;
+};
+
+struct BenchmarkResult {
+  std::string name;
+  int iterations;
+  // Number of processed items (points, pixels, images) in one run
+  long items;
+  double min_ms;
+  double mean_ms;
+  double median_ms;
+};
+
+// Keeps the compiler from optimizing away the results of the per point kernels
+volatile double sink;
+
+template <typename F>
+BenchmarkResult run_benchmark(const std::string& name, int iterations, long items, F body) {
+  BenchmarkResult result;
+  std::vector<double> times;
+
+  body();
+
+  for (int i = 0; i < iterations; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+    times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+  }
+
+  std::sort(times.begin(), times.end());
+
+  result.name = name;
+  result.iterations = iterations;
+  result.items = items;
+  result.min_ms = times.front();
+  result.mean_ms = 0;
+  for (int i = 0; i < times.size(); ++i) {
+    result.mean_ms += times[i] / times.size();
+  }
+  result.median_ms = times[times.size() / 2];
+
+  std::cout << std::left << std::setw(32) << name
+            << std::right << std::fixed << std::setprecision(3)
+            << std::setw(12) << result.median_ms << " ms"
+            << std::setw(12) << result.median_ms * 1e6 / items << " ns/item" << std::endl;
+
+  return result;
+}
+
+void benchmark_undistortion(const BenchmarkSettings& settings, std::vector<BenchmarkResult>& results) {
+  ocam_model o;
+
+  if (get_ocam_model(&o, settings.ocamCalibFileName.c_str()) != 0) {
+    return;
+  }
+
+  cv::Mat image = cv::imread(settings.undistortionFileName);
+
+  if (image.empty()) {
+    std::cout << "Could not read image: " << settings.undistortionFileName << std::endl;
+    return;
+  }
+
+  long pixels = static_cast<long>(image.rows) * image.cols;
+
+  // The same points the perspective LUT projects
+  std::vector<cv::Point3d> points3D;
+  float Nz = -image.cols / settings.scaleFactor;
+  for (int i = 0; i < image.rows; i++) {
+    for (int j = 0; j < image.cols; j++) {
+      points3D.push_back(cv::Point3d(i - image.rows / 2.0, j - image.cols / 2.0, Nz));
+    }
+  }
+
+  results.push_back(run_benchmark("world2cam", settings.iterations, points3D.size(), [&]() {
+    double point2D[2];
+    double point3D[3];
+    double sum = 0;
+    for (int i = 0; i < points3D.size(); ++i) {
+      point3D[0] = points3D[i].x; point3D[1] = points3D[i].y; point3D[2] = points3D[i].z;
+      world2cam(point2D, point3D, &o);
+      sum += point2D[0];
+    }
+    sink = sum;
+  }));
+
+  results.push_back(run_benchmark("cam2world", settings.iterations, pixels, [&]() {
+    double point2D[2];
+    double point3D[3];
+    double sum = 0;
+    for (int i = 0; i < image.rows; i++) {
+      for (int j = 0; j < image.cols; j++) {
+        point2D[0] = i; point2D[1] = j;
+        cam2world(point3D, point2D, &o);
+        sum += point3D[2];
+      }
+    }
+    sink = sum;
+  }));
+
+  cv::Mat map_x(image.size(), CV_32FC1);
+  cv::Mat map_y(image.size(), CV_32FC1);
+
+  results.push_back(run_benchmark("perspective_undistortion_LUT", settings.iterations, pixels, [&]() {
+    create_perspecive_undistortion_LUT(map_x, map_y, &o, settings.scaleFactor);
+  }));
+
+  std::map<std::string, int> interpolations = {
+    { "remap_nearest", cv::INTER_NEAREST },
+    { "remap_linear", cv::INTER_LINEAR },
+    { "remap_cubic", cv::INTER_CUBIC },
+    { "remap_lanczos4", cv::INTER_LANCZOS4 },
+  };
+
+  cv::Mat result = cv::Mat::zeros(image.size(), image.type());
+  for (const auto& interpolation : interpolations) {
+    results.push_back(run_benchmark(interpolation.first, settings.iterations, pixels, [&]() {
+      cv::remap(image, result, map_x, map_y, interpolation.second, 0);
+    }));
+  }
+}
+
+void benchmark_stitching(const BenchmarkSettings& settings, std::vector<BenchmarkResult>& results) {
+  stitch_model model;
+  std::vector<cv::Mat> images;
+
+  for (int i = 0; i < settings.cameraNumber; ++i) {
+    cv::Mat img = cv::imread(settings.stitchFileNames[i]);
+
+    if (img.empty()) {
+      std::cout << "Could not read image: " << settings.stitchFileNames[i] << std::endl;
+      return;
+    }
+
+    images.push_back(img);
+  }
+
+  long pixels = images[0].total();
+
+  get_stitch_model(model, settings.intrinsicFileNames, settings.rotationFileNames, std::vector<std::string>(), settings.cameraNumber);
+
+  cv::Size output_size;
+  int tr_x;
+  int tr_y;
+  get_panorama_layout(model, images[0].size(), output_size, tr_x, tr_y);
+  cv::Mat output_img = cv::Mat::zeros(output_size, images[0].type());
+
+  for (int i = 1; i <= settings.cameraNumber; ++i) {
+    results.push_back(run_benchmark("stitch_warp_camera" + std::to_string(i), settings.iterations, pixels, [&]() {
+      warp_camera(output_img, images[i - 1], model, i, tr_x, tr_y);
+    }));
+  }
+
+  // The warp with the map already built, as in service mode
+  for (int i = 1; i <= settings.cameraNumber; ++i) {
+    camera_warp warp;
+    create_cylindrical_warp_LUT(warp, model, i, images[i - 1].size(), output_size, tr_x, tr_y);
+
+    results.push_back(run_benchmark("stitch_apply_warp_LUT" + std::to_string(i), settings.iterations, pixels, [&]() {
+      apply_warp_LUT(output_img, images[i - 1], warp);
+    }));
+  }
+
+  // Preview decoded at a quarter of the resolution and stitched with the maps already built
+  int reduction = 4;
+  cv::Size preview_size((output_size.width + reduction - 1) / reduction, (output_size.height + reduction - 1) / reduction);
+  std::vector<camera_warp> preview_warps(settings.cameraNumber);
+  for (int i = 1; i <= settings.cameraNumber; ++i) {
+    create_cylindrical_warp_LUT(preview_warps[i - 1], model, i, images[i - 1].size(), preview_size, tr_x, tr_y, reduction);
+  }
+
+  results.push_back(run_benchmark("stitch_preview_reduced4", settings.iterations, settings.cameraNumber, [&]() {
+    cv::Mat preview_img = cv::Mat::zeros(preview_size, images[0].type());
+    for (int i = 1; i <= settings.cameraNumber; ++i) {
+      cv::Mat img = cv::imread(settings.stitchFileNames[i - 1], cv::IMREAD_REDUCED_COLOR_4);
+      apply_warp_LUT(preview_img, img, preview_warps[i - 1]);
+    }
+  }));
+}
+
+void benchmark_calibration(const BenchmarkSettings& settings, std::vector<BenchmarkResult>& results) {
+  cv::Size patternSize(settings.horizontalCornerNr, settings.verticalCornerNr);
+  std::vector<std::vector<cv::Point3f> > calibrationObjectPoints;
+  std::vector<std::vector<cv::Point2f> > imagePoints;
+  cv::Size imageSize;
+
+  for (int i = settings.firstCalibrationImageNr; i <= settings.lastCalibrationImageNr; ++i) {
+    std::string inputPath = settings.calibrationFileNames + std::to_string(i) + ".jpg";
+    cv::Mat image = cv::imread(inputPath, cv::IMREAD_GRAYSCALE);
+
+    if (image.empty()) {
+      std::cout << "Could not read image: " << inputPath << std::endl;
+      continue;
+    }
+
+    imageSize = image.size();
+    std::vector<cv::Point2f> imageCorners;
+    bool found = false;
+
+    results.push_back(run_benchmark("chessboard_corners_normal" + std::to_string(i), settings.iterations, 1, [&]() {
+      found = cv::findChessboardCorners(image, patternSize, imageCorners, cv::CALIB_CB_ADAPTIVE_THRESH);
+      if (found) {
+        cv::cornerSubPix(image, imageCorners, cv::Size(11, 11), cv::Size(-1, -1), cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::MAX_ITER, 30, 0.1));
+      }
+    }));
+
+    if (found && imageCorners.size() == settings.horizontalCornerNr * settings.verticalCornerNr) {
+      std::vector<cv::Point3f> objectPoints;
+      for (int j = 0; j < imageCorners.size(); ++j) {
+        objectPoints.push_back(cv::Point3f(j % settings.horizontalCornerNr * settings.squareLength, j / settings.horizontalCornerNr * settings.squareLength, 0));
+      }
+
+      imagePoints.push_back(imageCorners);
+      calibrationObjectPoints.push_back(objectPoints);
+    }
+  }
+
+  if (imagePoints.empty()) {
+    std::cout << "Cannot find corners on any image, skipping calibrateCamera" << std::endl;
+    return;
+  }
+
+  results.push_back(run_benchmark("calibrate_camera", settings.iterations, imagePoints.size(), [&]() {
+    cv::Mat intrinsicMatrix = cv::Mat(3, 3, CV_64F);
+    cv::Mat distortionCoeffs = cv::Mat::zeros(8, 1, CV_64F);
+    std::vector<cv::Mat> rotationVecs;
+    std::vector<cv::Mat> translationVecs;
+    cv::calibrateCamera(calibrationObjectPoints, imagePoints, imageSize, intrinsicMatrix, distortionCoeffs, rotationVecs, translationVecs, cv::CALIB_FIX_PRINCIPAL_POINT);
+  }));
+}
+
+// Undistorts the same frames end-to-end from JPEG files and from memory mapped raw frame files
+void benchmark_raw_frames(const BenchmarkSettings& settings, std::vector<BenchmarkResult>& results) {
+  ocam_model o;
+
+  if (get_ocam_model(&o, settings.ocamCalibFileName.c_str()) != 0) {
+    return;
+  }
+
+  cv::Mat image = cv::imread(settings.undistortionFileName);
+
+  if (image.empty()) {
+    std::cout << "Could not read image: " << settings.undistortionFileName << std::endl;
+    return;
+  }
+
+  cv::Mat map_x(image.size(), CV_32FC1);
+  cv::Mat map_y(image.size(), CV_32FC1);
+  cv::Mat chroma_map_x;
+  cv::Mat chroma_map_y;
+  create_perspecive_undistortion_LUT(map_x, map_y, &o, settings.scaleFactor);
+  create_chroma_maps(map_x, map_y, chroma_map_x, chroma_map_y);
+
+  int n = settings.rawFrameNumber;
+  std::vector<std::string> jpegFileNames;
+
+  for (int i = 0; i < n; ++i) {
+    jpegFileNames.push_back("benchmark-frame" + std::to_string(i) + ".jpg");
+    cv::imwrite(jpegFileNames[i], image);
+  }
+
+  results.push_back(run_benchmark("e2e_undistort_jpeg", settings.iterations, n, [&]() {
+    for (int i = 0; i < n; ++i) {
+      cv::Mat frame = cv::imread(jpegFileNames[i]);
+      cv::Mat result;
+      cv::remap(frame, result, map_x, map_y, cv::INTER_CUBIC, 0);
+      cv::imwrite("benchmark-result.jpg", result);
+    }
+  }));
+
+  std::map<std::string, RawLayout> formats = {
+    { "bgr", RAW_BGR },
+    { "nv12", RAW_NV12 },
+  };
+
+  for (const auto& format : formats) {
+    std::string inputFileName = "benchmark-frames." + format.first;
+    std::string outputFileName = "benchmark-result." + format.first;
+    RawFrameFile like;
+    RawFrameFile frames;
+    like.layout = format.second;
+
+    if (!create_raw_frames(frames, inputFileName, like, image.cols, image.rows, n)) {
+      continue;
+    }
+
+    for (int i = 0; i < n; ++i) {
+      std::vector<cv::Mat> planes = raw_frame_planes(frames, i);
+      bgr_to_raw_frame(image, planes, format.second);
+    }
+    close_raw_frames(frames);
+
+    results.push_back(run_benchmark("e2e_undistort_raw_" + format.first, settings.iterations, n, [&]() {
+      RawFrameFile input;
+      RawFrameFile output;
+
+      if (!open_raw_frames(input, inputFileName, format.first, image.cols, image.rows)) {
+        return;
+      }
+
+      if (create_raw_frames(output, outputFileName, input, input.width, input.height, input.frames.size())) {
+        for (int i = 0; i < input.frames.size(); ++i) {
+          std::vector<cv::Mat> planes = raw_frame_planes(input, i);
+          std::vector<cv::Mat> result = raw_frame_planes(output, i);
+          remap_frame(planes, result, input.layout, map_x, map_y, chroma_map_x, chroma_map_y, cv::INTER_CUBIC);
+        }
+      }
+
+      close_raw_frames(input);
+      close_raw_frames(output);
+    }));
+
+    remove(inputFileName.c_str());
+    remove(outputFileName.c_str());
+  }
+
+  for (int i = 0; i < n; ++i) {
+    remove(jpegFileNames[i].c_str());
+  }
+  remove("benchmark-result.jpg");
+}
+
+void write_results(const std::string& path, const std::vector<BenchmarkResult>& results) {
+  cv::FileStorage fs(path, cv::FileStorage::WRITE | cv::FileStorage::FORMAT_JSON);
+
+  fs << "benchmarks" << "[";
+  for (int i = 0; i < results.size(); ++i) {
+    fs << "{";
+    fs << "name" << results[i].name;
+    fs << "iterations" << results[i].iterations;
+    fs << "items" << static_cast<double>(results[i].items);
+    fs << "min_ms" << results[i].min_ms;
+    fs << "mean_ms" << results[i].mean_ms;
+    fs << "median_ms" << results[i].median_ms;
+    fs << "}";
+  }
+  fs << "]";
+
+  fs.release();
+  std::cout << "\nResults written to: " << path << std::endl;
+}
+
+// Reads the median times of a saved JSON file of results
+bool read_baseline(const std::string& path, std::map<std::string, double>& baseline) {
+  cv::FileStorage fs(path, cv::FileStorage::READ | cv::FileStorage::FORMAT_JSON);
+
+  if (!fs.isOpened()) {
+    std::cout << "Could not read baseline: " << path << std::endl;
+    return false;
+  }
+
+  cv::FileNode benchmarks = fs["benchmarks"];
+  for (cv::FileNodeIterator it = benchmarks.begin(); it != benchmarks.end(); ++it) {
+    baseline[(std::string)(*it)["name"]] = (double)(*it)["median_ms"];
+  }
+
+  return true;
+}
+
+// Returns the number of benchmarks whose median time is slower than the baseline by more than the threshold,
+// or that are in the baseline but did not run this time (e.g. because an input could not be read)
+int compare_results(const std::string& path, const std::map<std::string, double>& baseline, const std::vector<BenchmarkResult>& results, double threshold) {
+  std::map<std::string, double> current;
+  int regressions = 0;
+  std::cout << "\nComparing against baseline: " << path << " (threshold " << threshold << "%)" << std::endl;
+
+  for (int i = 0; i < results.size(); ++i) {
+    current[results[i].name] = results[i].median_ms;
+    auto it = baseline.find(results[i].name);
+
+    if (it == baseline.end()) {
+      std::cout << std::left << std::setw(32) << results[i].name << "  not in baseline" << std::endl;
+      continue;
+    }
+
+    double before = it->second;
+    double change = (results[i].median_ms - before) / before * 100;
+    bool regression = change > threshold;
+
+    std::cout << std::left << std::setw(32) << results[i].name
+              << std::right << std::fixed << std::setprecision(3)
+              << std::setw(12) << before << " ms ->"
+              << std::setw(12) << results[i].median_ms << " ms"
+              << std::setw(10) << std::setprecision(1) << std::showpos << change << "%" << std::noshowpos
+              << (regression ? "  REGRESSION" : "") << std::endl;
+
+    if (regression) {
+      regressions++;
+    }
+  }
+
+  for (const auto& entry : baseline) {
+    if (current.find(entry.first) == current.end()) {
+      std::cout << std::left << std::setw(32) << entry.first << "  MISSING, did not run" << std::endl;
+      regressions++;
+    }
+  }
+
+  return regressions;
+}
+
+int main(int argc, char *argv[]) {
+  BenchmarkSettings settings;
+
+  // Usage: benchmark.out [--iterations N] [--output results.json] [--compare baseline.json] [--threshold percent]
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string option = argv[i];
+
+    if (option == "--iterations") {
+      settings.iterations = std::max(1, std::stoi(argv[i + 1]));
+    } else if (option == "--output") {
+      settings.outputFileName = argv[i + 1];
+    } else if (option == "--compare") {
+      settings.baselineFileName = argv[i + 1];
+    } else if (option == "--threshold") {
+      settings.threshold = std::stod(argv[i + 1]);
+    } else {
+      std::cout << "Unknown option: " << option << std::endl;
+      return 2;
+    }
+  }
+
+  std::cout << "\nThis tool measures the hot paths of the undistortion, stitching and calibration tools.\n" << std::endl;
+
+  // The baseline is read before anything is written, so it can be the output file of the previous run
+  std::map<std::string, double> baseline;
+  if (!settings.baselineFileName.empty() && !read_baseline(settings.baselineFileName, baseline)) {
+    return 2;
+  }
+
+  std::vector<BenchmarkResult> results;
+  benchmark_undistortion(settings, results);
+  benchmark_stitching(settings, results);
+  benchmark_calibration(settings, results);
+  benchmark_raw_frames(settings, results);
+
+  write_results(settings.outputFileName, results);
+
+  if (!settings.baselineFileName.empty()) {
+    int regressions = compare_results(settings.baselineFileName, baseline, results, settings.threshold);
+
+    if (regressions > 0) {
+      std::cout << "\n" << regressions << " benchmark(s) regressed or did not run" << std::endl;
+      return 1;
+    }
+  }
+
+  return 0;
+}
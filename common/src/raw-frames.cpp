@@ -0,0 +1,387 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+#include <sstream>
+#include "raw-frames.h"
+
+static size_t frame_size(RawLayout layout, int width, int height) {
+  size_t pixels = static_cast<size_t>(width) * height;
+
+  switch (layout) {
+    case RAW_BGR: return pixels * 3;
+    case RAW_NV12: return pixels * 3 / 2;
+    case RAW_I420: return pixels * 3 / 2;
+    case RAW_YUV444: return pixels * 3;
+    case RAW_GRAY: return pixels;
+  }
+
+  return 0;
+}
+
+// Reads the size and the chroma layout from the header of a y4m file; returns the size of the header
+static size_t parse_y4m_header(RawFrameFile& file) {
+  const char *data = static_cast<const char *>(file.data);
+  const char *end = static_cast<const char *>(memchr(data, '\n', file.size));
+
+  if (file.size < 10 || memcmp(data, "YUV4MPEG2 ", 10) != 0 || end == nullptr) {
+    return 0;
+  }
+
+  std::istringstream header(std::string(data + 10, end));
+  std::string token;
+  std::string colorspace = "420jpeg";
+
+  while (header >> token) {
+    if (token[0] == 'W') {
+      file.width = std::stoi(token.substr(1));
+    } else if (token[0] == 'H') {
+      file.height = std::stoi(token.substr(1));
+    } else {
+      if (token[0] == 'C') {
+        colorspace = token.substr(1);
+      }
+      file.y4m_params += (file.y4m_params.empty() ? "" : " ") + token;
+    }
+  }
+
+  if (colorspace.compare(0, 3, "420") == 0) {
+    file.layout = RAW_I420;
+  } else if (colorspace == "444") {
+    file.layout = RAW_YUV444;
+  } else if (colorspace == "mono") {
+    file.layout = RAW_GRAY;
+  } else {
+    std::cout << "Unsupported y4m colorspace: " << colorspace << std::endl;
+    return 0;
+  }
+
+  return end - data + 1;
+}
+
+// Every y4m frame starts with a FRAME line, which may carry parameters of its own
+static bool find_y4m_frames(RawFrameFile& file, size_t offset) {
+  const char *data = static_cast<const char *>(file.data);
+  size_t length = frame_size(file.layout, file.width, file.height);
+
+  while (offset < file.size) {
+    const char *end = static_cast<const char *>(memchr(data + offset, '\n', file.size - offset));
+
+    if (file.size - offset < 5 || memcmp(data + offset, "FRAME", 5) != 0 || end == nullptr) {
+      return false;
+    }
+
+    offset = end - data + 1;
+    if (offset + length > file.size) {
+      return false;
+    }
+
+    file.frames.push_back(offset);
+    offset += length;
+  }
+
+  return true;
+}
+
+// Layout of the headerless formats
+static bool raw_layout(const std::string& format, RawLayout& layout) {
+  if (format == "bgr") {
+    layout = RAW_BGR;
+  } else if (format == "nv12") {
+    layout = RAW_NV12;
+  } else if (format == "i420") {
+    layout = RAW_I420;
+  } else {
+    std::cout << "Unsupported frame format: " << format << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool open_raw_frames(RawFrameFile& file, const std::string& path, const std::string& format, int width, int height) {
+  close_raw_frames(file);
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cout << "Could not open frames: " << path << std::endl;
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+
+  void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    std::cout << "Could not map frames: " << path << std::endl;
+    return false;
+  }
+
+  // The frames are read once from the start to the end
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+  file.data = data;
+  file.size = st.st_size;
+  file.width = width;
+  file.height = height;
+  file.y4m = format == "y4m";
+
+  bool valid = true;
+  if (file.y4m) {
+    size_t header = parse_y4m_header(file);
+    valid = header != 0 && find_y4m_frames(file, header);
+  } else {
+    valid = raw_layout(format, file.layout);
+
+    size_t length = frame_size(file.layout, file.width, file.height);
+    for (size_t offset = 0; valid && length != 0 && offset + length <= file.size; offset += length) {
+      file.frames.push_back(offset);
+    }
+  }
+
+  // The chroma planes of the 4:2:0 layouts have exactly half the size
+  if ((file.layout == RAW_NV12 || file.layout == RAW_I420) && (file.width % 2 != 0 || file.height % 2 != 0)) {
+    std::cout << "Frame size needs to be even for 4:2:0 frames" << std::endl;
+    valid = false;
+  }
+
+  if (!valid || file.width <= 0 || file.height <= 0 || file.frames.empty()) {
+    std::cout << "Could not read frames: " << path << std::endl;
+    close_raw_frames(file);
+    return false;
+  }
+
+  return true;
+}
+
+bool create_raw_frames(RawFrameFile& file, const std::string& path, const RawFrameFile& like, int width, int height, int frameNumber) {
+  close_raw_frames(file);
+
+  file.width = width;
+  file.height = height;
+  file.layout = like.layout;
+  file.y4m = like.y4m;
+  file.y4m_params = like.y4m_params;
+
+  std::string header;
+  std::string frameHeader;
+  if (file.y4m) {
+    header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height) + (file.y4m_params.empty() ? "" : " " + file.y4m_params) + "\n";
+    frameHeader = "FRAME\n";
+  }
+
+  size_t length = frame_size(file.layout, width, height);
+  size_t size = header.size() + (frameHeader.size() + length) * frameNumber;
+
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate(fd, size) != 0) {
+    std::cout << "Could not create frames: " << path << std::endl;
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+
+  void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    std::cout << "Could not map frames: " << path << std::endl;
+    return false;
+  }
+
+  file.data = data;
+  file.size = size;
+
+  char *bytes = static_cast<char *>(data);
+  memcpy(bytes, header.data(), header.size());
+
+  size_t offset = header.size();
+  for (int i = 0; i < frameNumber; ++i) {
+    memcpy(bytes + offset, frameHeader.data(), frameHeader.size());
+    offset += frameHeader.size();
+    file.frames.push_back(offset);
+    offset += length;
+  }
+
+  return true;
+}
+
+bool derive_raw_frames(const std::string& path, const std::string& format, const std::vector<std::string>& imageFileNames) {
+  if (access(path.c_str(), F_OK) == 0) {
+    return true;
+  }
+
+  RawFrameFile like;
+  if (format == "y4m") {
+    like.y4m = true;
+    like.layout = RAW_I420;
+    like.y4m_params = "F25:1 Ip A1:1 C420jpeg";
+  } else if (!raw_layout(format, like.layout)) {
+    return false;
+  }
+
+  std::vector<cv::Mat> images;
+  for (int i = 0; i < imageFileNames.size(); ++i) {
+    cv::Mat image = cv::imread(imageFileNames[i]);
+
+    if (!image.empty() && (images.empty() || image.size() == images[0].size())) {
+      images.push_back(image);
+    }
+  }
+
+  // The 4:2:0 layouts need an even frame size
+  if (images.empty() || (like.layout != RAW_BGR && (images[0].cols % 2 != 0 || images[0].rows % 2 != 0))) {
+    std::cout << "Could not derive frames: " << path << std::endl;
+    return false;
+  }
+
+  RawFrameFile file;
+  if (!create_raw_frames(file, path, like, images[0].cols, images[0].rows, images.size())) {
+    return false;
+  }
+
+  for (int i = 0; i < images.size(); ++i) {
+    std::vector<cv::Mat> planes = raw_frame_planes(file, i);
+    bgr_to_raw_frame(images[i], planes, file.layout);
+  }
+
+  close_raw_frames(file);
+  std::cout << "Derived " << images.size() << " frames from the images: " << path << std::endl;
+  return true;
+}
+
+void close_raw_frames(RawFrameFile& file) {
+  if (file.data != nullptr) {
+    munmap(file.data, file.size);
+  }
+
+  file = RawFrameFile();
+}
+
+std::vector<cv::Mat> raw_frame_planes(const RawFrameFile& file, int index) {
+  uchar *p = static_cast<uchar *>(file.data) + file.frames[index];
+  int w = file.width;
+  int h = file.height;
+  std::vector<cv::Mat> planes;
+
+  switch (file.layout) {
+    case RAW_BGR:
+      planes.push_back(cv::Mat(h, w, CV_8UC3, p));
+      break;
+    case RAW_NV12:
+      planes.push_back(cv::Mat(h, w, CV_8UC1, p));
+      planes.push_back(cv::Mat(h / 2, w / 2, CV_8UC2, p + w * h));
+      break;
+    case RAW_I420:
+      planes.push_back(cv::Mat(h, w, CV_8UC1, p));
+      planes.push_back(cv::Mat(h / 2, w / 2, CV_8UC1, p + w * h));
+      planes.push_back(cv::Mat(h / 2, w / 2, CV_8UC1, p + w * h + (w / 2) * (h / 2)));
+      break;
+    case RAW_YUV444:
+      planes.push_back(cv::Mat(h, w, CV_8UC1, p));
+      planes.push_back(cv::Mat(h, w, CV_8UC1, p + w * h));
+      planes.push_back(cv::Mat(h, w, CV_8UC1, p + 2 * w * h));
+      break;
+    case RAW_GRAY:
+      planes.push_back(cv::Mat(h, w, CV_8UC1, p));
+      break;
+  }
+
+  return planes;
+}
+
+void create_chroma_maps(const cv::Mat& map_x, const cv::Mat& map_y, cv::Mat& chroma_map_x, cv::Mat& chroma_map_y) {
+  cv::Size size((map_x.cols + 1) / 2, (map_x.rows + 1) / 2);
+
+  // The centre of chroma pixel x is luma pixel 2x + 0.5; the pixel centre aligned linear resize samples the map there
+  cv::resize(map_x, chroma_map_x, size, 0, 0, cv::INTER_LINEAR);
+  cv::resize(map_y, chroma_map_y, size, 0, 0, cv::INTER_LINEAR);
+
+  // (m + 0.5) / 2 - 0.5, from luma to chroma pixel centers
+  chroma_map_x.convertTo(chroma_map_x, CV_32FC1, 0.5, -0.25);
+  chroma_map_y.convertTo(chroma_map_y, CV_32FC1, 0.5, -0.25);
+}
+
+void remap_frame(const std::vector<cv::Mat>& src, std::vector<cv::Mat>& dst, RawLayout layout, const cv::Mat& map_x, const cv::Mat& map_y,
+                 const cv::Mat& chroma_map_x, const cv::Mat& chroma_map_y, int interpolation, int borderMode) {
+  for (int i = 0; i < src.size(); ++i) {
+    bool subsampled = src[i].size() != src[0].size();
+    bool chroma = i > 0 && layout != RAW_BGR;
+
+    cv::remap(src[i], dst[i], subsampled ? chroma_map_x : map_x, subsampled ? chroma_map_y : map_y,
+              interpolation, borderMode, chroma ? cv::Scalar::all(128) : cv::Scalar());
+  }
+}
+
+void raw_frame_to_bgr(const std::vector<cv::Mat>& planes, RawLayout layout, cv::Mat& bgr) {
+  int w = planes[0].cols;
+  int h = planes[0].rows;
+
+  switch (layout) {
+    case RAW_BGR:
+      bgr = planes[0];
+      break;
+    case RAW_NV12:
+      cv::cvtColor(cv::Mat(h * 3 / 2, w, CV_8UC1, planes[0].data), bgr, cv::COLOR_YUV2BGR_NV12);
+      break;
+    case RAW_I420:
+      cv::cvtColor(cv::Mat(h * 3 / 2, w, CV_8UC1, planes[0].data), bgr, cv::COLOR_YUV2BGR_I420);
+      break;
+    case RAW_YUV444: {
+      cv::Mat ycrcb;
+      cv::merge(std::vector<cv::Mat>{ planes[0], planes[2], planes[1] }, ycrcb);
+      cv::cvtColor(ycrcb, bgr, cv::COLOR_YCrCb2BGR);
+      break;
+    }
+    case RAW_GRAY:
+      cv::cvtColor(planes[0], bgr, cv::COLOR_GRAY2BGR);
+      break;
+  }
+}
+
+void bgr_to_raw_frame(const cv::Mat& bgr, std::vector<cv::Mat>& planes, RawLayout layout) {
+  int w = planes[0].cols;
+  int h = planes[0].rows;
+
+  switch (layout) {
+    case RAW_BGR:
+      if (bgr.data != planes[0].data) {
+        bgr.copyTo(planes[0]);
+      }
+      break;
+    case RAW_NV12: {
+      cv::Mat i420;
+      cv::cvtColor(bgr, i420, cv::COLOR_BGR2YUV_I420);
+      i420(cv::Rect(0, 0, w, h)).copyTo(planes[0]);
+
+      cv::Mat u(h / 2, w / 2, CV_8UC1, i420.data + w * h);
+      cv::Mat v(h / 2, w / 2, CV_8UC1, i420.data + w * h + (w / 2) * (h / 2));
+      cv::merge(std::vector<cv::Mat>{ u, v }, planes[1]);
+      break;
+    }
+    case RAW_I420: {
+      // The planes are contiguous, so the conversion writes straight into the frame
+      cv::Mat i420(h * 3 / 2, w, CV_8UC1, planes[0].data);
+      cv::cvtColor(bgr, i420, cv::COLOR_BGR2YUV_I420);
+      break;
+    }
+    case RAW_YUV444: {
+      cv::Mat ycrcb;
+      cv::cvtColor(bgr, ycrcb, cv::COLOR_BGR2YCrCb);
+      std::vector<cv::Mat> channels = { planes[0], planes[2], planes[1] };
+      cv::split(ycrcb, channels);
+      break;
+    }
+    case RAW_GRAY:
+      cv::cvtColor(bgr, planes[0], cv::COLOR_BGR2GRAY);
+      break;
+  }
+}
@@ -0,0 +1,84 @@
+/*------------------------------------------------------------------------------
+   Uncompressed frame files shared by the tools.
+
+   A file of raw frames is memory mapped and every frame is wrapped as cv::Mat
+   headers over the mapping, one for every plane, so nothing is copied or
+   decoded before the remap. Output files are created with their final size
+   and mapped the same way, so the remap writes straight into them.
+
+   Supported formats:
+       bgr   packed 8 bit BGR, the layout of a cv::Mat of CV_8UC3
+       nv12  Y plane followed by an interleaved UV plane of half resolution
+       i420  Y plane followed by U and V planes of half resolution
+       y4m   YUV4MPEG2 stream with C420* (i420), C444 or Cmono frames
+
+   Raw bgr, nv12 and i420 files hold frames back to back and need the frame
+   size to be given; y4m files carry it in their header.
+
+   Frames of other sources can be produced with ffmpeg, e.g.
+
+       ffmpeg -i input.mp4 -pix_fmt yuv420p frames.y4m
+       ffmpeg -i input.mp4 -pix_fmt nv12 -f rawvideo frames.nv12
+------------------------------------------------------------------------------*/
+
+#ifndef RAW_FRAMES_H
+#define RAW_FRAMES_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+enum RawLayout {
+  RAW_BGR,
+  RAW_NV12,
+  RAW_I420,
+  RAW_YUV444,
+  RAW_GRAY
+};
+
+struct RawFrameFile {
+  void *data = nullptr;
+  size_t size = 0;
+  int width = 0;
+  int height = 0;
+  RawLayout layout = RAW_BGR;
+  bool y4m = false;
+
+  // Header parameters of a y4m file other than the frame size, e.g. "F30:1 Ip A1:1 C420jpeg"
+  std::string y4m_params;
+
+  // Offset of the pixels of every frame in the mapping
+  std::vector<size_t> frames;
+};
+
+// Maps an existing file of raw frames; width and height are ignored for y4m files
+bool open_raw_frames(RawFrameFile& file, const std::string& path, const std::string& format, int width = 0, int height = 0);
+
+// Creates a file for frameNumber frames of the given size, in the layout (and container) of another file, and maps it
+bool create_raw_frames(RawFrameFile& file, const std::string& path, const RawFrameFile& like, int width, int height, int frameNumber);
+
+// Writes the images that can be read, in the given format, unless the file already exists
+// Used to derive the example frames from the example images; y4m files get 4:2:0 frames
+bool derive_raw_frames(const std::string& path, const std::string& format, const std::vector<std::string>& imageFileNames);
+
+void close_raw_frames(RawFrameFile& file);
+
+// Wraps the planes of a frame without copying; chroma planes of the 4:2:0 layouts have half the width and height
+std::vector<cv::Mat> raw_frame_planes(const RawFrameFile& file, int index);
+
+// Maps for the chroma planes of the 4:2:0 layouts, derived from the maps of the full resolution planes
+// The maps are interpolated at the chroma pixel centres, so they need to be smooth, without out of image markers
+void create_chroma_maps(const cv::Mat& map_x, const cv::Mat& map_y, cv::Mat& chroma_map_x, cv::Mat& chroma_map_y);
+
+// Remaps every plane of a frame into the planes of another frame of the same layout
+// Chroma planes are filled with neutral gray instead of zero outside of the source
+void remap_frame(const std::vector<cv::Mat>& src, std::vector<cv::Mat>& dst, RawLayout layout, const cv::Mat& map_x, const cv::Mat& map_y,
+                 const cv::Mat& chroma_map_x, const cv::Mat& chroma_map_y, int interpolation, int borderMode = cv::BORDER_CONSTANT);
+
+// Converts the planes of a frame to a BGR image; BGR frames are only wrapped, the others are converted into bgr
+void raw_frame_to_bgr(const std::vector<cv::Mat>& planes, RawLayout layout, cv::Mat& bgr);
+
+// Converts a BGR image into the planes of a frame
+void bgr_to_raw_frame(const cv::Mat& bgr, std::vector<cv::Mat>& planes, RawLayout layout);
+
+#endif
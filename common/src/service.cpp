@@ -0,0 +1,187 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <iostream>
+#include <sstream>
+#include "service.h"
+#include "trace.h"
+
+static bool send_line(int fd, const std::string& line) {
+  std::string data = line + "\n";
+  size_t sent = 0;
+
+  while (sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    sent += n;
+  }
+
+  return true;
+}
+
+// Handles the jobs of one client; returns true if the service has to shut down
+static bool serve_client(int fd, const ServiceHandler& handler) {
+  std::string buffer;
+  char chunk[4096];
+
+  while (true) {
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) {
+      return false;
+    }
+    buffer.append(chunk, n);
+
+    size_t end;
+    while ((end = buffer.find('\n')) != std::string::npos) {
+      std::istringstream line(buffer.substr(0, end));
+      buffer.erase(0, end + 1);
+
+      std::vector<std::string> args;
+      std::string arg;
+      while (line >> arg) {
+        args.push_back(arg);
+      }
+
+      if (args.empty()) {
+        continue;
+      }
+
+      if (args[0] == "PING") {
+        send_line(fd, "OK");
+      } else if (args[0] == "SHUTDOWN") {
+        send_line(fd, "OK");
+        return true;
+      } else {
+        std::string reply;
+        try {
+          reply = handler(args);
+        } catch (const std::exception& e) {
+          reply = std::string("ERROR ") + e.what();
+        }
+
+        // A resident process may never exit normally, so the events of every job are written right away
+        trace_flush();
+
+        if (!send_line(fd, reply)) {
+          return false;
+        }
+      }
+    }
+  }
+}
+
+int run_service(const std::string& socketPath, const ServiceHandler& handler) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+
+  if (socketPath.size() >= sizeof(address.sun_path)) {
+    std::cout << "Socket path is too long: " << socketPath << std::endl;
+    return -1;
+  }
+  socketPath.copy(address.sun_path, socketPath.size());
+
+  // A socket file left behind by a service that did not stop cleanly is replaced, but a running service is not
+  int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+  bool running = probe >= 0 && connect(probe, (sockaddr *)&address, sizeof(address)) == 0;
+  if (probe >= 0) {
+    close(probe);
+  }
+
+  if (running) {
+    std::cout << "Another service is already listening on: " << socketPath << std::endl;
+    return -1;
+  }
+
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server < 0) {
+    std::cout << "Could not create socket" << std::endl;
+    return -1;
+  }
+
+  // Only a socket is replaced; any other file at the path is most likely a wrong path
+  struct stat st;
+  if (lstat(socketPath.c_str(), &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      std::cout << "Not a socket, refusing to replace: " << socketPath << std::endl;
+      close(server);
+      return -1;
+    }
+
+    unlink(socketPath.c_str());
+  }
+
+  if (bind(server, (sockaddr *)&address, sizeof(address)) != 0 || listen(server, 8) != 0) {
+    std::cout << "Could not listen on socket: " << socketPath << std::endl;
+    close(server);
+    return -1;
+  }
+
+  std::cout << "Listening on " << socketPath << std::endl;
+
+  bool shutdown = false;
+  while (!shutdown) {
+    int client = accept(server, nullptr, nullptr);
+    if (client < 0) {
+      continue;
+    }
+
+    shutdown = serve_client(client, handler);
+    close(client);
+  }
+
+  close(server);
+  unlink(socketPath.c_str());
+  std::cout << "Service stopped" << std::endl;
+  return 0;
+}
+
+bool map_shared_frame(SharedFrame& frame, const std::string& name, int rows, int cols) {
+  // Negative sizes would wrap around to a small mapping that cv::Mat then refuses
+  if (rows <= 0 || cols <= 0) {
+    return false;
+  }
+
+  size_t size = static_cast<size_t>(rows) * cols * 3;
+
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < size) {
+    close(fd);
+    return false;
+  }
+
+  void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  frame.data = data;
+  frame.size = size;
+  frame.image = cv::Mat(rows, cols, CV_8UC3, data);
+  return true;
+}
+
+SharedFrame::~SharedFrame() {
+  unmap_shared_frame(*this);
+}
+
+void unmap_shared_frame(SharedFrame& frame) {
+  frame.image.release();
+
+  if (frame.data != nullptr) {
+    munmap(frame.data, frame.size);
+    frame.data = nullptr;
+    frame.size = 0;
+  }
+}
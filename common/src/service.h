@@ -0,0 +1,51 @@
+/*------------------------------------------------------------------------------
+   Resident service mode shared by the tools.
+
+   The service listens on a Unix domain socket and handles one job per line.
+   A job is a command followed by its space separated arguments, e.g.
+
+       UNDISTORT ../in.jpg ../out.jpg
+
+   and is answered by a single line starting with "OK" or "ERROR". A client
+   may send any number of jobs over one connection. The commands PING and
+   SHUTDOWN are handled by every service.
+
+   Frames can also be passed through POSIX shared memory objects (shm_open)
+   holding tightly packed 8 bit BGR pixels, so no encoding or decoding is
+   needed on either side.
+------------------------------------------------------------------------------*/
+
+#ifndef SERVICE_H
+#define SERVICE_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Handles one job; the returned line is sent back to the client
+typedef std::function<std::string(const std::vector<std::string>&)> ServiceHandler;
+
+// Serves jobs on the socket until a SHUTDOWN command; returns -1 if the socket cannot be set up
+int run_service(const std::string& socketPath, const ServiceHandler& handler);
+
+// The mapping is released when the frame goes out of scope, also when a job throws
+struct SharedFrame {
+  void *data = nullptr;
+  size_t size = 0;
+  cv::Mat image;
+
+  SharedFrame() {}
+  SharedFrame(const SharedFrame&) = delete;
+  SharedFrame& operator=(const SharedFrame&) = delete;
+  ~SharedFrame();
+};
+
+// Maps an existing shared memory object and wraps it as a rows x cols CV_8UC3 image without copying
+// Returns false without mapping anything if the size is not positive or the object is too small
+bool map_shared_frame(SharedFrame& frame, const std::string& name, int rows, int cols);
+
+// Releases the mapping before the frame goes out of scope
+void unmap_shared_frame(SharedFrame& frame);
+
+#endif
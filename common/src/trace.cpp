@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "trace.h"
+
+struct TraceEvent {
+  std::string name;
+  char phase;
+  long long timestamp;
+  long long duration;
+  double value;
+  int thread;
+};
+
+struct TraceState;
+static void write_trace(TraceState& state);
+
+struct TraceState {
+  std::string path;
+  std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+  std::vector<TraceEvent> events;
+  std::map<std::string, double> counters;
+  std::map<std::thread::id, int> threads;
+  std::mutex mutex;
+
+  // Number of events already in the trace file; they are dropped from events once written
+  long long written = 0;
+
+  TraceState() {
+    const char *env = getenv("CV_TOOLS_TRACE");
+    if (env != nullptr) {
+      path = env;
+    }
+  }
+
+  // The remaining events are written when the program exits
+  ~TraceState() {
+    write_trace(*this);
+  }
+};
+
+static TraceState& trace_state() {
+  static TraceState state;
+  return state;
+}
+
+bool trace_on = !trace_state().path.empty();
+
+static int trace_thread(TraceState& state) {
+  std::thread::id id = std::this_thread::get_id();
+  auto it = state.threads.find(id);
+  if (it == state.threads.end()) {
+    it = state.threads.insert(std::make_pair(id, static_cast<int>(state.threads.size()) + 1)).first;
+  }
+  return it->second;
+}
+
+long long trace_now() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - trace_state().origin).count();
+}
+
+void trace_event(const char *name, long long start, long long end) {
+  TraceState& state = trace_state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.events.push_back({ name, 'X', start, end - start, 0, trace_thread(state) });
+}
+
+void trace_counter(const char *name, double value) {
+  long long now = trace_now();
+  TraceState& state = trace_state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  double total = state.counters[name] += value;
+  state.events.push_back({ name, 'C', now, 0, total, trace_thread(state) });
+}
+
+void trace_flush() {
+  write_trace(trace_state());
+}
+
+// Appends the recorded events to the trace file; the file is closed after every write, so it stays valid
+// even if the process is killed later
+static void write_trace(TraceState& state) {
+  if (state.path.empty()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(state.mutex);
+  const std::string tail = "]}\n";
+  std::fstream file;
+
+  if (state.written == 0) {
+    file.open(state.path, std::ios::out | std::ios::trunc);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  } else {
+    // Overwrite the closing brackets of the previous write
+    file.open(state.path, std::ios::in | std::ios::out);
+    file.seekp(-static_cast<long long>(tail.size()), std::ios::end);
+  }
+
+  int pid = getpid();
+
+  // Counter totals such as bytes and pixels pass a million quickly; the default 6 digits would round them
+  file << std::setprecision(17);
+
+  for (int i = 0; i < state.events.size(); ++i) {
+    const TraceEvent& e = state.events[i];
+    file << (state.written > 0 ? "," : "")
+         << "{\"name\":\"" << e.name << "\",\"cat\":\"cv-tools\",\"ph\":\"" << e.phase
+         << "\",\"ts\":" << e.timestamp << ",\"pid\":" << pid << ",\"tid\":" << e.thread;
+
+    if (e.phase == 'X') {
+      file << ",\"dur\":" << e.duration;
+    } else {
+      file << ",\"args\":{\"value\":" << e.value << "}";
+    }
+
+    file << "}\n";
+    state.written++;
+  }
+
+  file << tail;
+  file.close();
+  state.events.clear();
+}
+
+double trace_file_size(const std::string& path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    return 0;
+  }
+  return static_cast<double>(st.st_size);
+}
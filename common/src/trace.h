@@ -0,0 +1,63 @@
+/*------------------------------------------------------------------------------
+   Lightweight hot path instrumentation shared by the tools.
+
+   Tracing is switched on by setting the CV_TOOLS_TRACE environment variable
+   to the path of the output file. The recorded stages and counters are
+   written there in the Chrome trace event format when the program exits,
+   so the run can be opened in chrome://tracing or ui.perfetto.dev. The
+   service mode also flushes them after every job.
+
+   When the variable is not set every TRACE_* macro costs a single branch;
+   building with -DCV_TOOLS_NO_TRACE removes them completely.
+------------------------------------------------------------------------------*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <string>
+
+extern bool trace_on;
+
+// Records a complete event; the times are in microseconds since the start of the program
+void trace_event(const char *name, long long start, long long end);
+
+// Adds value to the running total of the counter and records the new total
+void trace_counter(const char *name, double value);
+
+// Appends the events recorded since the last flush to the trace file and frees them
+void trace_flush();
+
+// Size of a file in bytes, or 0 if it does not exist
+double trace_file_size(const std::string& path);
+
+long long trace_now();
+
+// Times the enclosing scope
+class TraceScope {
+public:
+  TraceScope(const char *name) : name(name), start(trace_on ? trace_now() : -1) {}
+
+  ~TraceScope() {
+    if (start >= 0) {
+      trace_event(name, start, trace_now());
+    }
+  }
+
+private:
+  const char *name;
+  long long start;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#ifdef CV_TOOLS_NO_TRACE
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_COUNTER(name, value) do {} while (0)
+#else
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_COUNTER(name, value) do { if (trace_on) trace_counter(name, value); } while (0)
+#endif
+
+#endif
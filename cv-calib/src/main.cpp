@@ -2,6 +2,7 @@
 #include <fstream>
 #include <vector>
 #include <opencv2/opencv.hpp>
+#include "../../common/src/trace.h"
 
 struct CalibrationSettings {
   std::string inputFileNames = "../example/calibration/inputs/normal";
@@ -68,13 +69,18 @@ void write_data(const std::string& path, CalibrationResults results) {
 }
 
 FindCornerResults findChessboardCorners(const CalibrationSettings& settings) {
+    TRACE_SCOPE("findChessboardCorners");
     FindCornerResults results;
 
     std::cout << "Finding chessboard corners..." << std::endl;
     int i = 0;
     while (i <= settings.lastImageNr) {
         std::string inputPath = settings.inputFileNames + std::to_string(i) + "." + settings.extension;
-        cv::Mat image = cv::imread(inputPath, cv::IMREAD_GRAYSCALE);
+        cv::Mat image;
+        {
+            TRACE_SCOPE("imread");
+            image = cv::imread(inputPath, cv::IMREAD_GRAYSCALE);
+        }
 
          if (image.empty()) {
             std::cout << "Could not read image: " << inputPath << std::endl;
@@ -86,10 +92,22 @@ FindCornerResults findChessboardCorners(const CalibrationSettings& settings) {
             results.imageSize = cv::Size(image.cols, image.rows);
         }
 
+        TRACE_COUNTER("frames", 1);
+        TRACE_COUNTER("pixels", image.total());
+        TRACE_COUNTER("bytes_read", trace_file_size(inputPath));
+
         std::vector<cv::Point2f> imageCorners;
+        bool found;
+        {
+            TRACE_SCOPE("cv::findChessboardCorners");
+            found = cv::findChessboardCorners(image, cv::Size(settings.horizontalCornerNr, settings.verticalCornerNr), imageCorners, cv::CALIB_CB_ADAPTIVE_THRESH);
+        }
 
-        if (cv::findChessboardCorners(image, cv::Size(settings.horizontalCornerNr, settings.verticalCornerNr), imageCorners, cv::CALIB_CB_ADAPTIVE_THRESH)) {
-            cv::cornerSubPix(image, imageCorners, cv::Size(11, 11), cv::Size(-1, -1), cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::MAX_ITER, 30, 0.1));
+        if (found) {
+            {
+                TRACE_SCOPE("cornerSubPix");
+                cv::cornerSubPix(image, imageCorners, cv::Size(11, 11), cv::Size(-1, -1), cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::MAX_ITER, 30, 0.1));
+            }
             cv::drawChessboardCorners(image, cv::Size(settings.horizontalCornerNr, settings.verticalCornerNr), imageCorners, true);
             
             if (imageCorners.size() == settings.horizontalCornerNr * settings.verticalCornerNr) {
@@ -108,7 +126,12 @@ FindCornerResults findChessboardCorners(const CalibrationSettings& settings) {
                 results.corners.push_back(imageCorners);
                 
                 std::string resultPath = settings.cornerFileNames + std::to_string(i) + "." + settings.extension;
-                cv::imwrite(resultPath, image);
+                {
+                    TRACE_SCOPE("imwrite");
+                    cv::imwrite(resultPath, image);
+                }
+
+                TRACE_COUNTER("bytes_written", trace_file_size(resultPath));
             }
         } else {
             std::cout << "Cannot find corners on image: " << inputPath << std::endl;
@@ -121,26 +144,33 @@ FindCornerResults findChessboardCorners(const CalibrationSettings& settings) {
 }
 
 void calibrate_normal() {
+    TRACE_SCOPE("calibrate_normal");
     CalibrationSettings settings;
     CalibrationResults results;
     FindCornerResults corners = findChessboardCorners(settings);
 
     std::cout << "Calibrating camera..." << std::endl;
 
-    cv::calibrateCamera(
-        corners.calibrationObjectPoints,
-        corners.imagePoints,
-        corners.imageSize,
-        results.intrinsicMatrix,
-        results.distortionCoeffs,
-        results.rotationVecs,
-        results.translationVecs,
-        cv::CALIB_FIX_PRINCIPAL_POINT
-    );
+    {
+        TRACE_SCOPE("calibrateCamera");
+        cv::calibrateCamera(
+            corners.calibrationObjectPoints,
+            corners.imagePoints,
+            corners.imageSize,
+            results.intrinsicMatrix,
+            results.distortionCoeffs,
+            results.rotationVecs,
+            results.translationVecs,
+            cv::CALIB_FIX_PRINCIPAL_POINT
+        );
+    }
 
     std::cout << "Calibration completed!" << std::endl;
 
-    write_data(settings.calibResultFileName + ".txt", results);
+    {
+        TRACE_SCOPE("write_data");
+        write_data(settings.calibResultFileName + ".txt", results);
+    }
 }
 
 void extract_extrinsics() {
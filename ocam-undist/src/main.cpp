@@ -1,5 +1,10 @@
 #include <iostream>
+#include <chrono>
+#include <map>
 #include "ocam-functions.h"
+#include "../../common/src/raw-frames.h"
+#include "../../common/src/service.h"
+#include "../../common/src/trace.h"
 
 struct Settings {
     std::string calibFileName = "../example/undistortion/inputs/ocam-calib.txt";
@@ -8,18 +13,63 @@ struct Settings {
     std::string extension = "jpg";
     int lastImageNr = 4;
     float scaleFactor = 4.0;
+
+    // Uncompressed frames; bgr, nv12 and i420 files need the frame size, y4m files carry it in their header
+    // If the file does not exist it is derived from the input images above, one frame for every image
+    std::string rawInputFileName = "../example/undistortion/inputs/frames.y4m";
+    std::string rawFormat = "y4m";
+    int rawWidth = 960;
+    int rawHeight = 600;
+
+    // The frames are written in the same format; with an empty name they are written as images to resultFileNames instead
+    std::string rawResultFileName = "../example/undistortion/results/frames.y4m";
+
+    std::string socketPath = "/tmp/ocam-undist.sock";
+};
+
+struct UndistortionMaps {
+    cv::Mat map_x;
+    cv::Mat map_y;
 };
 
+// The maps only depend on the model and the image size, so they are built once for every size
+typedef std::map<std::pair<int, int>, UndistortionMaps> UndistortionMapCache;
+
+const UndistortionMaps& get_undistortion_maps(UndistortionMapCache& cache, ocam_model *o, const cv::Size& size, float sf) {
+    std::pair<int, int> key(size.height, size.width);
+    auto it = cache.find(key);
+
+    if (it == cache.end()) {
+        TRACE_SCOPE("create_perspecive_undistortion_LUT");
+        UndistortionMaps maps;
+        maps.map_x = cv::Mat(size, CV_32FC1);
+        maps.map_y = cv::Mat(size, CV_32FC1);
+        create_perspecive_undistortion_LUT(maps.map_x, maps.map_y, o, sf);
+        it = cache.insert(std::make_pair(key, maps)).first;
+    }
+
+    return it->second;
+}
+
 void undistortImages() {
+    TRACE_SCOPE("undistortImages");
     Settings settings;
     ocam_model o;
+    UndistortionMapCache cache;
 
-    get_ocam_model(&o, settings.calibFileName.c_str());
+    {
+        TRACE_SCOPE("get_ocam_model");
+        get_ocam_model(&o, settings.calibFileName.c_str());
+    }
 
     int i = 0;
     while (i <= settings.lastImageNr) {
         std::string inputPath = settings.inputFileNames + std::to_string(i) + "." + settings.extension;
-        cv::Mat image = cv::imread(inputPath);
+        cv::Mat image;
+        {
+            TRACE_SCOPE("imread");
+            image = cv::imread(inputPath);
+        }
 
         if (image.empty()) {
             std::cout << "Could not read image: " << inputPath << std::endl;
@@ -35,20 +85,176 @@ void undistortImages() {
         world2cam(point2D, point3D, &o);
         cam2world(point3D, point2D, &o);
         
-        cv::Mat map_x(image.size(), CV_32FC1);
-        cv::Mat map_y(image.size(), CV_32FC1);
-
-        create_perspecive_undistortion_LUT(map_x, map_y, &o, settings.scaleFactor);
+        const UndistortionMaps& maps = get_undistortion_maps(cache, &o, image.size(), settings.scaleFactor);
 
-        cv::remap(image, result, map_x, map_y, cv::INTER_CUBIC, 0);
+        {
+            TRACE_SCOPE("remap");
+            cv::remap(image, result, maps.map_x, maps.map_y, cv::INTER_CUBIC, 0);
+        }
 
         std::string result_path = settings.resultFileNames + std::to_string(i) + "." + settings.extension;
-        cv::imwrite(result_path, result);
+        {
+            TRACE_SCOPE("imwrite");
+            cv::imwrite(result_path, result);
+        }
+
+        TRACE_COUNTER("frames", 1);
+        TRACE_COUNTER("pixels", image.total());
+        TRACE_COUNTER("bytes_read", trace_file_size(inputPath));
+        TRACE_COUNTER("bytes_written", trace_file_size(result_path));
+
         std::cout << "Processing image: " << inputPath << std::endl;
         i++;
     }
 }
 
+// Keeps the model and the maps in memory and undistorts the images sent over the socket
+//   UNDISTORT <input path> <output path>
+//   UNDISTORT_SHM <input shm> <output shm> <width> <height>
+void undistortService() {
+    Settings settings;
+    ocam_model o;
+    UndistortionMapCache cache;
+
+    if (get_ocam_model(&o, settings.calibFileName.c_str()) != 0) {
+        return;
+    }
+
+    run_service(settings.socketPath, [&](const std::vector<std::string>& args) -> std::string {
+        TRACE_SCOPE("job");
+        auto start = std::chrono::steady_clock::now();
+
+        if (args[0] == "UNDISTORT" && args.size() == 3) {
+            cv::Mat image;
+            {
+                TRACE_SCOPE("imread");
+                image = cv::imread(args[1]);
+            }
+
+            if (image.empty()) {
+                return "ERROR Could not read image: " + args[1];
+            }
+
+            const UndistortionMaps& maps = get_undistortion_maps(cache, &o, image.size(), settings.scaleFactor);
+            cv::Mat result;
+            {
+                TRACE_SCOPE("remap");
+                cv::remap(image, result, maps.map_x, maps.map_y, cv::INTER_CUBIC, 0);
+            }
+
+            {
+                TRACE_SCOPE("imwrite");
+                if (!cv::imwrite(args[2], result)) {
+                    return "ERROR Could not write image: " + args[2];
+                }
+            }
+
+            TRACE_COUNTER("frames", 1);
+            TRACE_COUNTER("pixels", image.total());
+        } else if (args[0] == "UNDISTORT_SHM" && args.size() == 5) {
+            int cols = std::stoi(args[3]);
+            int rows = std::stoi(args[4]);
+            SharedFrame input;
+            SharedFrame output;
+
+            if (rows <= 0 || cols <= 0) {
+                return "ERROR Invalid frame size: " + args[3] + " " + args[4];
+            }
+
+            if (args[1] == args[2] || !map_shared_frame(input, args[1], rows, cols) || !map_shared_frame(output, args[2], rows, cols)) {
+                return "ERROR Could not map shared memory: " + args[1] + " " + args[2];
+            }
+
+            // The result is written straight into the output shared memory
+            const UndistortionMaps& maps = get_undistortion_maps(cache, &o, input.image.size(), settings.scaleFactor);
+            {
+                TRACE_SCOPE("remap");
+                cv::remap(input.image, output.image, maps.map_x, maps.map_y, cv::INTER_CUBIC, 0);
+            }
+
+            TRACE_COUNTER("frames", 1);
+            TRACE_COUNTER("pixels", input.image.total());
+        } else {
+            return "ERROR Unknown command: " + args[0];
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        return "OK " + std::to_string(std::chrono::duration<double, std::milli>(end - start).count());
+    });
+}
+
+// Undistorts memory mapped raw frames without decoding or copying them
+void undistortRawFrames() {
+    TRACE_SCOPE("undistortRawFrames");
+    Settings settings;
+    ocam_model o;
+    UndistortionMapCache cache;
+    RawFrameFile input;
+    RawFrameFile output;
+
+    if (get_ocam_model(&o, settings.calibFileName.c_str()) != 0) {
+        return;
+    }
+
+    std::vector<std::string> imageFileNames;
+    for (int i = 0; i <= settings.lastImageNr; ++i) {
+        imageFileNames.push_back(settings.inputFileNames + std::to_string(i) + "." + settings.extension);
+    }
+
+    if (!derive_raw_frames(settings.rawInputFileName, settings.rawFormat, imageFileNames) ||
+        !open_raw_frames(input, settings.rawInputFileName, settings.rawFormat, settings.rawWidth, settings.rawHeight)) {
+        return;
+    }
+
+    bool rawOutput = !settings.rawResultFileName.empty();
+    if (rawOutput && !create_raw_frames(output, settings.rawResultFileName, input, input.width, input.height, input.frames.size())) {
+        close_raw_frames(input);
+        return;
+    }
+
+    const UndistortionMaps& maps = get_undistortion_maps(cache, &o, cv::Size(input.width, input.height), settings.scaleFactor);
+    cv::Mat chroma_map_x;
+    cv::Mat chroma_map_y;
+
+    if (input.layout == RAW_NV12 || input.layout == RAW_I420) {
+        create_chroma_maps(maps.map_x, maps.map_y, chroma_map_x, chroma_map_y);
+    }
+
+    for (int i = 0; i < input.frames.size(); ++i) {
+        std::vector<cv::Mat> planes = raw_frame_planes(input, i);
+
+        if (rawOutput) {
+            // Every plane is remapped straight into the mapped output file
+            std::vector<cv::Mat> result = raw_frame_planes(output, i);
+            TRACE_SCOPE("remap");
+            remap_frame(planes, result, input.layout, maps.map_x, maps.map_y, chroma_map_x, chroma_map_y, cv::INTER_CUBIC);
+        } else {
+            cv::Mat image;
+            cv::Mat result;
+            raw_frame_to_bgr(planes, input.layout, image);
+
+            {
+                TRACE_SCOPE("remap");
+                cv::remap(image, result, maps.map_x, maps.map_y, cv::INTER_CUBIC, 0);
+            }
+
+            std::string result_path = settings.resultFileNames + std::to_string(i) + "." + settings.extension;
+            {
+                TRACE_SCOPE("imwrite");
+                cv::imwrite(result_path, result);
+            }
+        }
+
+        TRACE_COUNTER("frames", 1);
+        TRACE_COUNTER("pixels", planes[0].total());
+    }
+
+    std::cout << "Processed " << input.frames.size() << " frames of: " << settings.rawInputFileName << std::endl;
+
+    close_raw_frames(input);
+    close_raw_frames(output);
+}
+
 void undistortVideo() {
     std::cout << "TODO: implement video undistortion" << std::endl;
 }
@@ -63,12 +269,16 @@ int main(int argc, char *argv[]) {
         std::cout << "\t[0] Exit" << std::endl;
         std::cout << "\t[1] Set of images" << std::endl;
         std::cout << "\t[2] Video" << std::endl;
+        std::cout << "\t[3] Service mode on " << Settings().socketPath << std::endl;
+        std::cout << "\t[4] Raw frames" << std::endl;
         std::cout << ">>" && std::cin >> action;
 
         switch (action) {
             case 0: break; 
             case 1: undistortImages(); break;
             case 2: undistortVideo(); break;
+            case 3: undistortService(); break;
+            case 4: undistortRawFrames(); break;
         }
     }
 
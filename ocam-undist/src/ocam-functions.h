@@ -5,6 +5,9 @@
    Author: Davide Scaramuzza - email: davide.scaramuzza@ieee.org
 ------------------------------------------------------------------------------*/
 
+#ifndef OCAM_FUNCTIONS_H
+#define OCAM_FUNCTIONS_H
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <float.h>
@@ -86,3 +89,5 @@ void create_perspecive_undistortion_LUT(cv::Mat& mapx, cv::Mat& mapy, struct oca
  xc, yc are the row and column coordinates of the image center
 ------------------------------------------------------------------------------*/
 //void create_panoramic_undistortion_LUT ( CvMat *mapx, CvMat *mapy, float Rmin, float Rmax, float xc, float yc );
+
+#endif
@@ -1,4 +1,4 @@
-g++ src/main.cpp -o stitcher.out \
+g++ src/main.cpp src/stitch-functions.cpp src/pyramid.cpp ../ocam-undist/src/ocam-functions.cpp ../common/src/raw-frames.cpp ../common/src/service.cpp ../common/src/trace.cpp -o stitcher.out \
     -I /usr/local/include/opencv4 \
     -lopencv_core \
     -lopencv_highgui \
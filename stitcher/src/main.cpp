@@ -1,7 +1,11 @@
 #include <iostream>
+#include <chrono>
 #include <fstream>
-#include <math.h>
-#include <opencv2/opencv.hpp>
+#include "stitch-functions.h"
+#include "pyramid.h"
+#include "../../common/src/raw-frames.h"
+#include "../../common/src/service.h"
+#include "../../common/src/trace.h"
 
 struct Settings {
   // Number of cameras
@@ -35,178 +39,461 @@ struct Settings {
     "../example/stitching/inputs/camera-params/R8.txt",
   };
 
+  // Omnidirectional (ocam) calibration of every camera; with an empty name the camera is treated as a pinhole camera
+  // A fisheye camera with a calibration is undistorted and stitched in the same pass
+  std::vector<std::string> ocamFileNames = {
+    "",
+    "",
+    "",
+    "",
+    "",
+  };
+
   // std::vector<std::string> translationFileNames = {
   //   "t"
   // };
+
+  // Quick preview; the images are decoded and stitched reduced this many times (2, 4 and 8 are decoded directly)
+  int previewReduction = 4;
+  std::string previewFileName = "../example/stitching/results/preview.jpg";
+
+  // Deep Zoom pyramid of the full resolution result; <name>.dzi and the tiles in <name>_files
+  std::string pyramidFileName = "../example/stitching/results/result";
+  int tileSize = 256;
+
+  // Uncompressed frames of every camera; bgr, nv12 and i420 files need the frame size, y4m files carry it in their header
+  // A file that does not exist is derived from the input image of its camera, as a single frame
+  std::vector<std::string> rawInputFileNames = {
+    "../example/stitching/inputs/images/stitch1.y4m",
+    "../example/stitching/inputs/images/stitch2.y4m",
+    "../example/stitching/inputs/images/stitch3.y4m",
+    "../example/stitching/inputs/images/stitch4.y4m",
+    "../example/stitching/inputs/images/stitch5.y4m",
+  };
+  std::string rawFormat = "y4m";
+  int rawWidth = 960;
+  int rawHeight = 600;
+
+  // The panoramas are written in the format of the first camera; with an empty name they are written as images instead
+  std::string rawOutputFileName = "../example/stitching/results/result.y4m";
+
+  std::string socketPath = "/tmp/stitcher.sock";
+};
+
+// The warp maps of every camera for one input image size
+struct StitchCache {
+  // Full resolution size of the input images, also for a reduced cache
+  cv::Size input_size;
+  cv::Size output_size;
+  int reduction = 1;
+  std::vector<camera_warp> warps;
 };
 
+// size is the full resolution size of the input images; the maps are built for the images reduced by the given factor,
+// which are rounded up like the decoder rounds them, so a preview is laid out exactly like the full result
+void build_stitch_cache(StitchCache& cache, const stitch_model& model, int cameraNumber, const cv::Size& size, int reduction = 1) {
+  TRACE_SCOPE("create_cylindrical_warp_LUT");
+  cv::Size output_size;
+  int tr_x;
+  int tr_y;
+
+  get_panorama_layout(model, size, output_size, tr_x, tr_y);
+  cache.input_size = size;
+  cache.output_size = cv::Size((output_size.width + reduction - 1) / reduction, (output_size.height + reduction - 1) / reduction);
+  cache.reduction = reduction;
+  cache.warps.assign(cameraNumber, camera_warp());
+
+  for (int i = 1; i <= cameraNumber; ++i) {
+    create_cylindrical_warp_LUT(cache.warps[i - 1], model, i, size, cache.output_size, tr_x, tr_y, reduction);
+  }
+}
+
+// Size of a JPEG image from its frame header, without decoding it; returns an empty size for other files
+cv::Size read_jpeg_size(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  unsigned char b[7];
+
+  if (!file.read((char *)b, 2) || b[0] != 0xFF || b[1] != 0xD8) {
+    return cv::Size();
+  }
+
+  while (file.read((char *)b, 2) && b[0] == 0xFF) {
+    int marker = b[1];
+
+    // Markers without a segment
+    if (marker == 0xFF) {
+      file.seekg(-1, std::ios::cur);
+      continue;
+    }
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD9)) {
+      continue;
+    }
+
+    if (!file.read((char *)b, 2)) {
+      break;
+    }
+    int length = (b[0] << 8) | b[1];
+
+    // Start of frame markers, except DHT, JPG and DAC
+    if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+      if (!file.read((char *)b, 5)) {
+        break;
+      }
+      return cv::Size((b[3] << 8) | b[4], (b[1] << 8) | b[2]);
+    }
+
+    file.seekg(length - 2, std::ios::cur);
+  }
+
+  return cv::Size();
+}
+
+// Reads the images decoded reduced by the given factor; returns false if one is missing or has a different size
+// full_size is set to the size of the images before the reduction
+bool read_images(std::vector<cv::Mat>& images, cv::Size& full_size, const std::vector<std::string>& paths, int reduction = 1) {
+  int flags = cv::IMREAD_COLOR;
+
+  // libjpeg decodes these directly at the lower resolution
+  switch (reduction) {
+    case 2: flags = cv::IMREAD_REDUCED_COLOR_2; break;
+    case 4: flags = cv::IMREAD_REDUCED_COLOR_4; break;
+    case 8: flags = cv::IMREAD_REDUCED_COLOR_8; break;
+  }
+
+  images.clear();
+  for (int i = 0; i < paths.size(); ++i) {
+    TRACE_SCOPE("imread");
+    cv::Mat img = cv::imread(paths[i], flags);
+    cv::Size size = img.size();
+
+    // Other reductions are not supported by the decoder
+    if (!img.empty() && reduction > 1 && flags == cv::IMREAD_COLOR) {
+      cv::resize(img, img, cv::Size((img.cols + reduction - 1) / reduction, (img.rows + reduction - 1) / reduction), 0, 0, cv::INTER_AREA);
+    } else if (!img.empty() && reduction > 1 && i == 0) {
+      // The decoder rounds the reduced size up, so the full size is taken from the header; it may be rotated by the EXIF orientation
+      cv::Size header = read_jpeg_size(paths[i]);
+      cv::Size rotated(header.height, header.width);
+      auto reduced = [&](const cv::Size& s) { return cv::Size((s.width + reduction - 1) / reduction, (s.height + reduction - 1) / reduction); };
+
+      if (!header.empty() && reduced(header) == img.size()) {
+        size = header;
+      } else if (!header.empty() && reduced(rotated) == img.size()) {
+        size = rotated;
+      } else {
+        size = cv::imread(paths[i], cv::IMREAD_COLOR).size();
+      }
+    }
+
+    if (img.empty() || (i > 0 && img.size() != images[0].size())) {
+      std::cout << "Could not read image: " << paths[i] << std::endl;
+      return false;
+    }
+
+    if (i == 0) {
+      full_size = size;
+    }
+
+    images.push_back(img);
+
+    TRACE_COUNTER("bytes_read", trace_file_size(paths[i]));
+  }
+
+  return true;
+}
+
+// Counters of every mode: frames and pixels of the camera inputs, and the panoramas made of them
+void render_panorama(cv::Mat& output_img, const std::vector<cv::Mat>& images, const StitchCache& cache) {
+  // TODO: add image ordering
+  // For every camera...
+  for (int i = 0; i < images.size(); ++i) {
+    TRACE_SCOPE("apply_warp_LUT");
+    apply_warp_LUT(output_img, images[i], cache.warps[i]);
+
+    TRACE_COUNTER("frames", 1);
+    TRACE_COUNTER("pixels", images[i].total());
+  }
+
+  TRACE_COUNTER("panoramas", 1);
+}
+
+// Warps every plane of the camera frames into the planes of the output frame, so YUV frames are stitched without converting them
+// The chroma planes of the 4:2:0 layouts are warped with the maps of chroma_cache, built for half the resolution
+void render_panorama_planes(std::vector<cv::Mat>& output_planes, const std::vector<std::vector<cv::Mat> >& frames, RawLayout layout,
+                            const StitchCache& cache, const StitchCache& chroma_cache) {
+  for (int p = 0; p < output_planes.size(); ++p) {
+    bool subsampled = output_planes[p].size() != output_planes[0].size();
+    bool chroma = p > 0 && layout != RAW_BGR;
+
+    // Pixels no camera sees are black, so their chroma is neutral
+    output_planes[p].setTo(cv::Scalar::all(chroma ? 128 : 0));
+
+    for (int i = 0; i < frames.size(); ++i) {
+      TRACE_SCOPE("apply_warp_LUT");
+      apply_warp_LUT(output_planes[p], frames[i][p], subsampled ? chroma_cache.warps[i] : cache.warps[i]);
+    }
+  }
+
+  for (int i = 0; i < frames.size(); ++i) {
+    TRACE_COUNTER("frames", 1);
+    TRACE_COUNTER("pixels", frames[i][0].total());
+  }
+
+  TRACE_COUNTER("panoramas", 1);
+}
+
 template <typename T>
 void read(T &data, const std::string& instruction) {
   std::cout << instruction << std::endl;
   std::cout << ">>" && std::cin >> data;
 }
 
-cv::Mat read_parameter(const std::string& path, const int& rows = 3, const int& cols = 3) {
-  cv::Mat m = cv::Mat(rows, cols, CV_64F);
-  std::ifstream file(path);
+// Stitches the images of the settings; with a reduction they are decoded and stitched at a lower resolution
+bool stitch(cv::Mat& output_img, const Settings& settings, int reduction = 1) {
+  stitch_model model;
+  std::vector<cv::Mat> images;
+  cv::Size full_size;
 
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < cols; j++) {
-      std::string str;
-      file >> str;
-      m.at<double>(i, j) = std::stod(str);
-    }
+  if (!read_images(images, full_size, std::vector<std::string>(settings.inputFileNames.begin(), settings.inputFileNames.begin() + settings.cameraNumber), reduction)) {
+    return false;
+  }
+
+  {
+    TRACE_SCOPE("get_stitch_model");
+    get_stitch_model(model, settings.intrinsicFileNames, settings.rotationFileNames, settings.ocamFileNames, settings.cameraNumber);
   }
 
-  file.close();
-  return m;
+  // The size needs to be the same for every image in this case
+  StitchCache cache;
+  build_stitch_cache(cache, model, settings.cameraNumber, full_size, reduction);
+
+  output_img = cv::Mat::zeros(cache.output_size, images[0].type());
+  render_panorama(output_img, images, cache);
+  return true;
 }
 
-cv::Point3d transform(const cv::Point3d& point, const cv::Mat& rotation_matrix, const cv::Mat& translation_vector) {
-  cv::Point3f transformed_point;
-  cv::Mat t_point(3, 1, CV_64F);
+void stitch_images() {
+  TRACE_SCOPE("stitch_images");
+  Settings settings;
+  cv::Mat output_img;
+
+  if (!stitch(output_img, settings)) {
+    return;
+  }
 
-  t_point.at<double>(0, 0) = point.x;
-  t_point.at<double>(1, 0) = point.y;
-  t_point.at<double>(2, 0) = point.z;
+  // Write results
+  {
+    TRACE_SCOPE("imwrite");
+    cv::imwrite(settings.outputFileName, output_img);
+  }
 
-  cv::Mat res = rotation_matrix * (t_point + translation_vector);
-  return cv::Point3d(res.at<double>(0, 0), res.at<double>(1, 0), res.at<double>(2, 0));
+  TRACE_COUNTER("bytes_written", trace_file_size(settings.outputFileName));
 }
 
-void stitch_images() {
+void stitch_preview() {
+  TRACE_SCOPE("stitch_preview");
   Settings settings;
-  std::vector<cv::Mat> images;
-  std::vector<cv::Mat> intrinsics;
-  std::vector<cv::Mat> r_mats;
-  std::vector<double> focal_lengths;
-  std::vector<cv::Mat> r_y_mats;
-  std::vector<cv::Mat> rotations;
+  cv::Mat output_img;
 
-  // Store the image paths in a vector
-  for (int i = 0; i < settings.cameraNumber; ++i) {
-    cv::Mat img = cv::imread(settings.inputFileNames[i]);
-    images.push_back(img);
+  if (!stitch(output_img, settings, settings.previewReduction)) {
+    return;
   }
 
-  // The height and width; it needs to be the same for every image in this case
-  int HEIGHT = images[0].size().height;
-  int WIDTH = images[0].size().width;
-
-  // Read the INTRINSIC camera parameters for every types of camera; in this case normal + fisheye
-  for (int i = 0; i < settings.cameraTypes; ++i) {
-    cv::Mat K = read_parameter(settings.intrinsicFileNames[i]);
-    intrinsics.push_back(K);
-  }
-
-  // Read the EXTRINSIC camera parameters, R and t
-  int extrinsicsNumber = (settings.cameraNumber - 1) * 2;
-  for (int i = 0; i < extrinsicsNumber; ++i) {
-    cv::Mat R = read_parameter(settings.rotationFileNames[i]);
-    r_mats.push_back(-R.t());
-  }
-
-  // Constants of image centers on the x and y axes
-  double c_x = intrinsics[0].at<double>(0,2);
-  double c_y = intrinsics[0].at<double>(1,2);
-
-  // Extraction of the focal lengths of the of the camera types
-  // Here I took the average of the focal lengths of the x and y axes
-  for (int i = 0; i < settings.cameraTypes; ++i) {
-    double f = (intrinsics[i].at<double>(0,0) + intrinsics[i].at<double>(1,1)) / 2;
-    focal_lengths.push_back(f);
-  }
-
-  // Extraction of the rotation around the y axis from the rotations of the cameras
-  // We do this for every parameter
-  // 
-  for (int i = 0; i < r_mats.size(); ++i) {
-    // I couldn't find out why I used the asin function here.
-    // https://en.wikipedia.org/wiki/Euler_angles
-    // https://stackoverflow.com/questions/15022630/how-to-calculate-the-angle-from-rotation-matrix
-    double theta = asin(r_mats[i].at<double>(2,0));
-    
-    // https://en.wikipedia.org/wiki/Rotation_matrix
-    cv::Mat r_y(3, 3, CV_64F);
-    r_y.at<double>(0, 0) = cos(theta); r_y.at<double>(0, 1) = 0; r_y.at<double>(0, 2) = sin(theta); 
-    r_y.at<double>(1, 0) = 0; r_y.at<double>(1, 1) = 1; r_y.at<double>(1, 2) = 0; 
-    r_y.at<double>(2, 0) = -sin(theta); r_y.at<double>(2, 1) = 0; r_y.at<double>(2, 2) = cos(theta);
-    r_y_mats.push_back(r_y);
-  }
-
-  // TODO: refactor
-  // Calculate the rotations cumulatively
-  cv::Mat rotation1 = r_y_mats[0];
-  cv::Mat rotation2 = r_y_mats[1];
-  cv::Mat rotation3 = (r_y_mats[3] * r_y_mats[2].inv()) * rotation2;
-  cv::Mat rotation4 = (r_y_mats[5] * r_y_mats[4].inv()) * rotation3;
-  cv::Mat rotation5 = (r_y_mats[7] * r_y_mats[6].inv()) * rotation4;
-  rotations.push_back(rotation1);
-  rotations.push_back(rotation2);
-  rotations.push_back(rotation3);
-  rotations.push_back(rotation4);
-  rotations.push_back(rotation5);
-
-  // Define a zero translation vector; we use this as we don't count the translation between the cameras, only the rotations
-  cv::Mat t0(3, 1, CV_64F);
-  t0.at<double>(0, 0) = 0;
-  t0.at<double>(1, 0) = 0;
-  t0.at<double>(2, 0) = 0;
-
-  // The scaling is only good for two camera types
-  double f_scale = focal_lengths[0] / focal_lengths[1];
-  double s = *max_element(focal_lengths.begin(), focal_lengths.end());
-
-  cv::Mat output_img = cv::Mat::zeros(HEIGHT * 2, WIDTH * 2, images[0].type());
-  int tr_x = 0;
-  int tr_y = (output_img.rows / 2) - ( (HEIGHT / f_scale) / 2);
-  
-  // TODO: add image ordering
-  // For every camera...
-  for (int i = 1; i <= settings.cameraNumber; ++i) {
-    double f;
+  {
+    TRACE_SCOPE("imwrite");
+    cv::imwrite(settings.previewFileName, output_img);
+  }
 
-    // Change the focal length for the middle (fisheye) camera
-    if (i == 3) {
-      f = focal_lengths[1];
-    } else {
-      f = focal_lengths[0];
-    }
-
-    // Iterate through every image point
-    for (int y = 0; y < HEIGHT; y++) {
-      for (int x = 0; x < WIDTH; x++) {
-        // Back projected point & its transformed (rotated) point; from image coodrinate system to world coordinate system
-        cv::Point3d bp_point(static_cast<double>(x) - c_x, static_cast<double>(y) - c_y, f);
-        cv::Point3d t_point = transform(bp_point, rotations[i - 1], t0);
-
-        // Cylindrical projection
-        double h = bp_point.y / sqrt(f * f + bp_point.x * bp_point.x);
-        double delta;
-
-        // This handles the overlapping; it is because of the atan2 gives bad result when x and z are both negative
-        if (i != 1 && t_point.x < 0 && t_point.z < 0) {
-          t_point.x = -t_point.x;
-          t_point.z = -t_point.z;
-          delta = atan2(t_point.x, t_point.z);
-          delta = delta + M_PI;
-        } else {
-          delta = atan2(t_point.x, t_point.z);
+  TRACE_COUNTER("bytes_written", trace_file_size(settings.previewFileName));
+}
+
+void stitch_pyramid() {
+  TRACE_SCOPE("stitch_pyramid");
+  Settings settings;
+  cv::Mat output_img;
+
+  if (!stitch(output_img, settings)) {
+    return;
+  }
+
+  TRACE_SCOPE("write_deep_zoom_pyramid");
+  if (!write_deep_zoom_pyramid(output_img, settings.pyramidFileName, settings.tileSize)) {
+    std::cout << "Could not write pyramid: " << settings.pyramidFileName << std::endl;
+    return;
+  }
+
+  std::cout << "Pyramid written to: " << settings.pyramidFileName << ".dzi" << std::endl;
+}
+
+// Keeps the model and the warp maps in memory and stitches the images sent over the socket
+//   STITCH <output path> <input path 1> ... <input path N>
+//   PREVIEW <output path> <input path 1> ... <input path N>
+//   STITCH_SHM <output shm> <width> <height> <input shm 1> ... <input shm N>
+// The output shared memory holds a (2 * height) x (2 * width) image
+void stitch_service() {
+  Settings settings;
+  stitch_model model;
+  StitchCache cache;
+  StitchCache preview_cache;
+
+  get_stitch_model(model, settings.intrinsicFileNames, settings.rotationFileNames, settings.ocamFileNames, settings.cameraNumber);
+
+  run_service(settings.socketPath, [&](const std::vector<std::string>& args) -> std::string {
+    TRACE_SCOPE("job");
+    auto start = std::chrono::steady_clock::now();
+
+    if ((args[0] == "STITCH" || args[0] == "PREVIEW") && args.size() == 2 + settings.cameraNumber) {
+      bool preview = args[0] == "PREVIEW";
+      StitchCache& job_cache = preview ? preview_cache : cache;
+      int reduction = preview ? settings.previewReduction : 1;
+      std::vector<cv::Mat> images;
+      cv::Size full_size;
+
+      if (!read_images(images, full_size, std::vector<std::string>(args.begin() + 2, args.end()), reduction)) {
+        return "ERROR Could not read images";
+      }
+
+      if (job_cache.warps.empty() || job_cache.input_size != full_size) {
+        build_stitch_cache(job_cache, model, settings.cameraNumber, full_size, reduction);
+      }
+
+      cv::Mat output_img = cv::Mat::zeros(job_cache.output_size, images[0].type());
+      render_panorama(output_img, images, job_cache);
+
+      {
+        TRACE_SCOPE("imwrite");
+        if (!cv::imwrite(args[1], output_img)) {
+          return "ERROR Could not write image: " + args[1];
         }
+      }
+    } else if (args[0] == "STITCH_SHM" && args.size() == 4 + settings.cameraNumber) {
+      cv::Size size(std::stoi(args[2]), std::stoi(args[3]));
 
-        // Scaling of the points (different focal lengths)
-        int new_x = round((c_x + s * delta) / f_scale);
-        int new_y = round((c_y + s * h) / f_scale);
+      if (size.width <= 0 || size.height <= 0) {
+        return "ERROR Invalid frame size: " + args[2] + " " + args[3];
+      }
 
-        // Translate the point based on its position to be a panoramic image
-        i == 1 && x == 0 && y == 0 ? tr_x = -new_x : tr_x = tr_x;
-        output_img.at<cv::Vec3b>(new_y + tr_y, new_x + tr_x) = images[i - 1].at<cv::Vec3b>(y, x);
+      std::vector<SharedFrame> inputs(settings.cameraNumber);
+      SharedFrame output;
+      bool mapped = map_shared_frame(output, args[1], size.height * 2, size.width * 2);
+
+      for (int i = 0; i < settings.cameraNumber && mapped; ++i) {
+        mapped = map_shared_frame(inputs[i], args[4 + i], size.height, size.width);
       }
+
+      // The frames are unmapped when they go out of scope
+      if (!mapped) {
+        return "ERROR Could not map shared memory";
+      }
+
+      if (cache.warps.empty() || cache.input_size != size) {
+        build_stitch_cache(cache, model, settings.cameraNumber, size);
+      }
+
+      std::vector<cv::Mat> images;
+      for (int i = 0; i < settings.cameraNumber; ++i) {
+        images.push_back(inputs[i].image);
+      }
+
+      // The panorama is rendered straight into the output shared memory
+      output.image.setTo(cv::Scalar::all(0));
+      render_panorama(output.image, images, cache);
+    } else {
+      return "ERROR Unknown command: " + args[0];
+    }
+
+    TRACE_COUNTER("jobs", 1);
+
+    auto end = std::chrono::steady_clock::now();
+    return "OK " + std::to_string(std::chrono::duration<double, std::milli>(end - start).count());
+  });
+}
+
+// Stitches memory mapped raw frames without decoding or copying them; with a raw output every plane is warped
+// straight into the mapped output file, otherwise the frames are converted to BGR and written as images
+void stitch_raw_frames() {
+  TRACE_SCOPE("stitch_raw_frames");
+  Settings settings;
+  stitch_model model;
+  std::vector<RawFrameFile> inputs(settings.cameraNumber);
+  RawFrameFile output;
+  int frameNumber = 0;
+  bool opened = true;
+  bool sameLayout = true;
+
+  for (int i = 0; i < settings.cameraNumber && opened; ++i) {
+    opened = derive_raw_frames(settings.rawInputFileNames[i], settings.rawFormat, std::vector<std::string>(1, settings.inputFileNames[i])) &&
+             open_raw_frames(inputs[i], settings.rawInputFileNames[i], settings.rawFormat, settings.rawWidth, settings.rawHeight);
+
+    if (opened && (inputs[i].width != inputs[0].width || inputs[i].height != inputs[0].height)) {
+      std::cout << "Frame size differs: " << settings.rawInputFileNames[i] << std::endl;
+      opened = false;
+    }
+
+    if (opened) {
+      frameNumber = i == 0 ? inputs[i].frames.size() : std::min(frameNumber, static_cast<int>(inputs[i].frames.size()));
+      sameLayout = sameLayout && inputs[i].layout == inputs[0].layout;
     }
   }
 
-  // Write results
-  cv::imwrite(settings.outputFileName, output_img);
+  get_stitch_model(model, settings.intrinsicFileNames, settings.rotationFileNames, settings.ocamFileNames, settings.cameraNumber);
+
+  StitchCache cache;
+  StitchCache chroma_cache;
+  bool rawOutput = !settings.rawOutputFileName.empty();
+
+  // The output is in the layout of the first camera; the planes are only warped directly if every camera uses it
+  bool planar = rawOutput && sameLayout;
+
+  if (opened) {
+    cv::Size size(inputs[0].width, inputs[0].height);
+    build_stitch_cache(cache, model, settings.cameraNumber, size);
+
+    if (planar && (inputs[0].layout == RAW_NV12 || inputs[0].layout == RAW_I420)) {
+      build_stitch_cache(chroma_cache, model, settings.cameraNumber, size, 2);
+    }
+
+    opened = !rawOutput || create_raw_frames(output, settings.rawOutputFileName, inputs[0], cache.output_size.width, cache.output_size.height, frameNumber);
+  }
+
+  for (int f = 0; f < frameNumber && opened; ++f) {
+    if (planar) {
+      std::vector<std::vector<cv::Mat> > frames(settings.cameraNumber);
+      for (int i = 0; i < settings.cameraNumber; ++i) {
+        frames[i] = raw_frame_planes(inputs[i], f);
+      }
+
+      std::vector<cv::Mat> planes = raw_frame_planes(output, f);
+      render_panorama_planes(planes, frames, output.layout, cache, chroma_cache);
+      continue;
+    }
+
+    std::vector<cv::Mat> images(settings.cameraNumber);
+    for (int i = 0; i < settings.cameraNumber; ++i) {
+      raw_frame_to_bgr(raw_frame_planes(inputs[i], f), inputs[i].layout, images[i]);
+    }
+
+    cv::Mat output_img = cv::Mat::zeros(cache.output_size, CV_8UC3);
+    render_panorama(output_img, images, cache);
+
+    if (rawOutput) {
+      std::vector<cv::Mat> planes = raw_frame_planes(output, f);
+      bgr_to_raw_frame(output_img, planes, output.layout);
+    } else {
+      std::string extension = settings.outputFileName.substr(settings.outputFileName.find_last_of('.'));
+      std::string outputPath = settings.outputFileName.substr(0, settings.outputFileName.find_last_of('.')) + std::to_string(f) + extension;
+      TRACE_SCOPE("imwrite");
+      cv::imwrite(outputPath, output_img);
+    }
+  }
+
+  if (opened) {
+    std::cout << "Stitched " << frameNumber << " frames" << std::endl;
+  }
+
+  for (int i = 0; i < settings.cameraNumber; ++i) {
+    close_raw_frames(inputs[i]);
+  }
+  close_raw_frames(output);
 }
 
 void stitch_video() {
@@ -222,12 +509,20 @@ int main(int argc, char** argv) {
     std::cout << "\t[0] Exit" << std::endl;
     std::cout << "\t[1] Set of images" << std::endl;
     std::cout << "\t[2] Video" << std::endl;
+    std::cout << "\t[3] Service mode on " << Settings().socketPath << std::endl;
+    std::cout << "\t[4] Quick preview of a set of images" << std::endl;
+    std::cout << "\t[5] Deep Zoom pyramid of a set of images" << std::endl;
+    std::cout << "\t[6] Raw frames" << std::endl;
     std::cout << ">>" && std::cin >> action;
 
     switch (action) {
       case 0: break;
       case 1: stitch_images(); break;
       case 2: stitch_video(); break;
+      case 3: stitch_service(); break;
+      case 4: stitch_preview(); break;
+      case 5: stitch_pyramid(); break;
+      case 6: stitch_raw_frames(); break;
     }
   }
 
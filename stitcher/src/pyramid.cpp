@@ -0,0 +1,66 @@
+#include <errno.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <iostream>
+#include "pyramid.h"
+
+// Creates a directory; an existing one is reused, so a pyramid can be written over the previous one
+static bool make_directory(const std::string& path) {
+  if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+    std::cout << "Could not create directory: " << path << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool write_deep_zoom_pyramid(const cv::Mat& image, const std::string& path, int tileSize, const std::string& extension) {
+  std::string tilesPath = path + "_files";
+  if (!make_directory(tilesPath)) {
+    return false;
+  }
+
+  int maxLevel = ceil(log2(std::max(image.cols, image.rows)));
+  cv::Mat level = image;
+
+  // Every level is built from the previous, larger one instead of warping the sources again
+  for (int l = maxLevel; l >= 0; --l) {
+    std::string levelPath = tilesPath + "/" + std::to_string(l);
+    if (!make_directory(levelPath)) {
+      return false;
+    }
+
+    for (int row = 0; row * tileSize < level.rows; ++row) {
+      for (int col = 0; col * tileSize < level.cols; ++col) {
+        cv::Rect tile(col * tileSize, row * tileSize, std::min(tileSize, level.cols - col * tileSize), std::min(tileSize, level.rows - row * tileSize));
+        std::string tilePath = levelPath + "/" + std::to_string(col) + "_" + std::to_string(row) + "." + extension;
+
+        if (!cv::imwrite(tilePath, level(tile))) {
+          std::cout << "Could not write tile: " << tilePath << std::endl;
+          return false;
+        }
+      }
+    }
+
+    if (l > 0) {
+      cv::Mat next;
+      cv::resize(level, next, cv::Size((level.cols + 1) / 2, (level.rows + 1) / 2), 0, 0, cv::INTER_AREA);
+      level = next;
+    }
+  }
+
+  std::string descriptorPath = path + ".dzi";
+  std::ofstream file(descriptorPath, std::ios::trunc);
+  file << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << std::endl;
+  file << "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" TileSize=\"" << tileSize << "\" Overlap=\"0\" Format=\"" << extension << "\">" << std::endl;
+  file << "  <Size Width=\"" << image.cols << "\" Height=\"" << image.rows << "\"/>" << std::endl;
+  file << "</Image>" << std::endl;
+  file.close();
+
+  if (!file) {
+    std::cout << "Could not write descriptor: " << descriptorPath << std::endl;
+    return false;
+  }
+
+  return true;
+}
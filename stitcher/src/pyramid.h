@@ -0,0 +1,12 @@
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include <string>
+#include <opencv2/opencv.hpp>
+
+// Writes the image as a Deep Zoom pyramid: path.dzi and the tiles in path_files/<level>/<column>_<row>.<extension>
+// Every level is half the size of the next one and is resized from it, down to a single pixel at level 0
+// Returns false, after reporting the path, if a directory, a tile or the descriptor cannot be written
+bool write_deep_zoom_pyramid(const cv::Mat& image, const std::string& path, int tileSize = 256, const std::string& extension = "jpg");
+
+#endif
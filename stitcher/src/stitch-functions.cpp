@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include "stitch-functions.h"
+
+cv::Mat read_parameter(const std::string& path, const int& rows, const int& cols) {
+  cv::Mat m = cv::Mat(rows, cols, CV_64F);
+  std::ifstream file(path);
+
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < cols; j++) {
+      std::string str;
+      file >> str;
+      m.at<double>(i, j) = std::stod(str);
+    }
+  }
+
+  file.close();
+  return m;
+}
+
+void get_stitch_model(stitch_model& model, const std::vector<std::string>& intrinsicFileNames, const std::vector<std::string>& rotationFileNames, const std::vector<std::string>& ocamFileNames, int cameraNumber) {
+  std::vector<cv::Mat> intrinsics;
+  std::vector<cv::Mat> r_mats;
+  std::vector<cv::Mat> r_y_mats;
+
+  model.rotations.clear();
+  model.focal_lengths.clear();
+  model.ocam_models.clear();
+
+  // Read the INTRINSIC camera parameters for every types of camera; in this case normal + fisheye
+  for (int i = 0; i < intrinsicFileNames.size(); ++i) {
+    cv::Mat K = read_parameter(intrinsicFileNames[i]);
+    intrinsics.push_back(K);
+  }
+
+  // Read the EXTRINSIC camera parameters, R and t
+  int extrinsicsNumber = (cameraNumber - 1) * 2;
+  for (int i = 0; i < extrinsicsNumber; ++i) {
+    cv::Mat R = read_parameter(rotationFileNames[i]);
+    r_mats.push_back(-R.t());
+  }
+
+  // Read the omnidirectional models of the fisheye cameras
+  for (int i = 0; i < ocamFileNames.size() && i < cameraNumber; ++i) {
+    ocam_model o;
+
+    if (!ocamFileNames[i].empty() && get_ocam_model(&o, ocamFileNames[i].c_str()) == 0) {
+      model.ocam_models[i + 1] = o;
+    }
+  }
+
+  // Constants of image centers on the x and y axes
+  model.c_x = intrinsics[0].at<double>(0,2);
+  model.c_y = intrinsics[0].at<double>(1,2);
+
+  // Extraction of the focal lengths of the of the camera types
+  // Here I took the average of the focal lengths of the x and y axes
+  for (int i = 0; i < intrinsics.size(); ++i) {
+    double f = (intrinsics[i].at<double>(0,0) + intrinsics[i].at<double>(1,1)) / 2;
+    model.focal_lengths.push_back(f);
+  }
+
+  // Extraction of the rotation around the y axis from the rotations of the cameras
+  // We do this for every parameter
+  //
+  for (int i = 0; i < r_mats.size(); ++i) {
+    // I couldn't find out why I used the asin function here.
+    // https://en.wikipedia.org/wiki/Euler_angles
+    // https://stackoverflow.com/questions/15022630/how-to-calculate-the-angle-from-rotation-matrix
+    double theta = asin(r_mats[i].at<double>(2,0));
+
+    // https://en.wikipedia.org/wiki/Rotation_matrix
+    cv::Mat r_y(3, 3, CV_64F);
+    r_y.at<double>(0, 0) = cos(theta); r_y.at<double>(0, 1) = 0; r_y.at<double>(0, 2) = sin(theta);
+    r_y.at<double>(1, 0) = 0; r_y.at<double>(1, 1) = 1; r_y.at<double>(1, 2) = 0;
+    r_y.at<double>(2, 0) = -sin(theta); r_y.at<double>(2, 1) = 0; r_y.at<double>(2, 2) = cos(theta);
+    r_y_mats.push_back(r_y);
+  }
+
+  // TODO: refactor
+  // Calculate the rotations cumulatively
+  cv::Mat rotation1 = r_y_mats[0];
+  cv::Mat rotation2 = r_y_mats[1];
+  cv::Mat rotation3 = (r_y_mats[3] * r_y_mats[2].inv()) * rotation2;
+  cv::Mat rotation4 = (r_y_mats[5] * r_y_mats[4].inv()) * rotation3;
+  cv::Mat rotation5 = (r_y_mats[7] * r_y_mats[6].inv()) * rotation4;
+  model.rotations.push_back(rotation1);
+  model.rotations.push_back(rotation2);
+  model.rotations.push_back(rotation3);
+  model.rotations.push_back(rotation4);
+  model.rotations.push_back(rotation5);
+
+  // The scaling is only good for two camera types
+  model.f_scale = model.focal_lengths[0] / model.focal_lengths[1];
+  model.s = *max_element(model.focal_lengths.begin(), model.focal_lengths.end());
+}
+
+// Focal length of a pinhole camera; the middle (fisheye) camera is approximated with its own focal length
+static double focal_length(const stitch_model& model, int i) {
+  return i == 3 ? model.focal_lengths[1] : model.focal_lengths[0];
+}
+
+// Omnidirectional model of the i-th camera, or nullptr for the pinhole cameras
+static const ocam_model *find_ocam_model(const stitch_model& model, int i) {
+  auto it = model.ocam_models.find(i);
+  return it == model.ocam_models.end() ? nullptr : &it->second;
+}
+
+// Back projects an image point of the i-th camera to a ray in the camera coordinate system (x right, y down, z forward)
+static cv::Vec3d back_project(const stitch_model& model, int i, double x, double y) {
+  const ocam_model *o = find_ocam_model(model, i);
+
+  if (o == nullptr) {
+    return cv::Vec3d(x - model.c_x, y - model.c_y, focal_length(model, i));
+  }
+
+  // The ocam model works with [row; column] points and looks towards -z
+  double point2D[2] = { y, x };
+  double point3D[3];
+  cam2world(point3D, point2D, const_cast<ocam_model *>(o));
+  return cv::Vec3d(point3D[1], point3D[0], -point3D[2]);
+}
+
+// Largest angle of view of an omnidirectional camera, as the elevation used by world2cam; it is reached on the image border
+// Beyond it the inverse polynomial is extrapolated and may fold back into the image
+static double ocam_max_theta(const ocam_model *o) {
+  double max_theta = -M_PI / 2;
+  int w = o->width;
+  int h = o->height;
+
+  for (int k = 0; k < 2 * (w + h); ++k) {
+    double point2D[2];
+    double point3D[3];
+
+    if (k < w) {
+      point2D[0] = 0; point2D[1] = k;
+    } else if (k < 2 * w) {
+      point2D[0] = h - 1; point2D[1] = k - w;
+    } else if (k < 2 * w + h) {
+      point2D[0] = k - 2 * w; point2D[1] = 0;
+    } else {
+      point2D[0] = k - 2 * w - h; point2D[1] = w - 1;
+    }
+
+    cam2world(point3D, point2D, const_cast<ocam_model *>(o));
+    max_theta = std::max(max_theta, atan2(point3D[2], sqrt(point3D[0] * point3D[0] + point3D[1] * point3D[1])));
+  }
+
+  return max_theta;
+}
+
+// Projects a ray in the camera coordinate system to an image point; returns false if the camera cannot see it
+static bool project(const stitch_model& model, const ocam_model *o, double f, double max_theta, const cv::Vec3d& ray, double& x, double& y) {
+  if (o == nullptr) {
+    if (ray[2] <= 0) {
+      return false;
+    }
+
+    x = f * ray[0] / ray[2] + model.c_x;
+    y = f * ray[1] / ray[2] + model.c_y;
+    return true;
+  }
+
+  // Rays outside of the calibrated field of view, e.g. behind the lens
+  double point3D[3] = { ray[1], ray[0], -ray[2] };
+  if (atan2(point3D[2], sqrt(point3D[0] * point3D[0] + point3D[1] * point3D[1])) > max_theta) {
+    return false;
+  }
+
+  double point2D[2];
+  world2cam(point2D, point3D, const_cast<ocam_model *>(o));
+  x = point2D[1];
+  y = point2D[0];
+  return x >= 0 && y >= 0 && x <= o->width - 1 && y <= o->height - 1;
+}
+
+// Cylindrical projection of an image point of the i-th camera, before the panoramic translation
+static cv::Point2d cylinder_point(const stitch_model& model, int i, double x, double y) {
+  // Back projected point & its transformed (rotated) point; from image coodrinate system to world coordinate system
+  cv::Matx33d rotation = model.rotations[i - 1];
+  cv::Vec3d t_point = rotation * back_project(model, i, x, y);
+
+  double h = t_point[1] / sqrt(t_point[0] * t_point[0] + t_point[2] * t_point[2]);
+  double delta = atan2(t_point[0], t_point[2]);
+
+  // This handles the overlapping; it is because of the atan2 gives bad result when x and z are both negative
+  if (i != 1 && t_point[0] < 0 && t_point[2] < 0) {
+    delta = delta + 2 * M_PI;
+  }
+
+  // Scaling of the points (different focal lengths)
+  return cv::Point2d((model.c_x + model.s * delta) / model.f_scale, (model.c_y + model.s * h) / model.f_scale);
+}
+
+void get_panorama_layout(const stitch_model& model, const cv::Size& image_size, cv::Size& output_size, int& tr_x, int& tr_y) {
+  output_size = cv::Size(image_size.width * 2, image_size.height * 2);
+  tr_x = -round(cylinder_point(model, 1, 0, 0).x);
+  tr_y = (output_size.height / 2) - ( (image_size.height / model.f_scale) / 2);
+}
+
+void create_cylindrical_warp_LUT(camera_warp& warp, const stitch_model& model, int i, const cv::Size& image_size, const cv::Size& output_size, int tr_x, int tr_y, int reduction) {
+  // The region of the output image is bounded by the projection of the image border
+  double min_x = DBL_MAX, min_y = DBL_MAX, max_x = -DBL_MAX, max_y = -DBL_MAX;
+  int w = image_size.width;
+  int h = image_size.height;
+
+  for (int k = 0; k < 2 * (w + h); ++k) {
+    cv::Point2d p;
+
+    if (k < w) {
+      p = cylinder_point(model, i, k, 0);
+    } else if (k < 2 * w) {
+      p = cylinder_point(model, i, k - w, h - 1);
+    } else if (k < 2 * w + h) {
+      p = cylinder_point(model, i, 0, k - 2 * w);
+    } else {
+      p = cylinder_point(model, i, w - 1, k - 2 * w - h);
+    }
+
+    if (!std::isfinite(p.x) || !std::isfinite(p.y)) {
+      continue;
+    }
+
+    min_x = std::min(min_x, p.x); max_x = std::max(max_x, p.x);
+    min_y = std::min(min_y, p.y); max_y = std::max(max_y, p.y);
+  }
+
+  warp.roi = cv::Rect(0, 0, 0, 0);
+  if (min_x > max_x) {
+    return;
+  }
+
+  // The map is built in reduced output coordinates and points into the reduced camera image
+  double k = reduction;
+  int x0 = floor((min_x + tr_x) / k) - 1;
+  int y0 = floor((min_y + tr_y) / k) - 1;
+  int x1 = ceil((max_x + tr_x) / k) + 1;
+  int y1 = ceil((max_y + tr_y) / k) + 1;
+  warp.roi = cv::Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1) & cv::Rect(0, 0, output_size.width, output_size.height);
+  warp.map_x.create(warp.roi.size(), CV_32FC1);
+  warp.map_y.create(warp.roi.size(), CV_32FC1);
+
+  // The inverse rotation; from world coordinate system to the camera coordinate system
+  cv::Matx33d rotation = model.rotations[i - 1];
+  cv::Matx33d r_inv = rotation.t();
+  const ocam_model *o = find_ocam_model(model, i);
+  double f = focal_length(model, i);
+  double max_theta = o == nullptr ? 0 : ocam_max_theta(o);
+
+  // The angle around the cylinder only depends on the column
+  std::vector<double> sin_delta(warp.roi.width);
+  std::vector<double> cos_delta(warp.roi.width);
+  for (int x = 0; x < warp.roi.width; x++) {
+    double delta = (((warp.roi.x + x + 0.5) * k - 0.5 - tr_x) * model.f_scale - model.c_x) / model.s;
+    sin_delta[x] = sin(delta);
+    cos_delta[x] = cos(delta);
+  }
+
+  for (int y = 0; y < warp.roi.height; y++) {
+    double height = (((warp.roi.y + y + 0.5) * k - 0.5 - tr_y) * model.f_scale - model.c_y) / model.s;
+    float *map_x = warp.map_x.ptr<float>(y);
+    float *map_y = warp.map_y.ptr<float>(y);
+
+    for (int x = 0; x < warp.roi.width; x++) {
+      cv::Vec3d ray = r_inv * cv::Vec3d(sin_delta[x], height, cos_delta[x]);
+      double src_x, src_y;
+
+      // Points that are not seen by the camera are mapped outside of the image
+      if (project(model, o, f, max_theta, ray, src_x, src_y)) {
+        map_x[x] = (float)((src_x + 0.5) / k - 0.5);
+        map_y[x] = (float)((src_y + 0.5) / k - 0.5);
+      } else {
+        map_x[x] = -1;
+        map_y[x] = -1;
+      }
+    }
+  }
+}
+
+void apply_warp_LUT(cv::Mat& output_img, const cv::Mat& image, const camera_warp& warp) {
+  if (warp.roi.area() == 0) {
+    return;
+  }
+
+  cv::Mat region = output_img(warp.roi);
+  cv::remap(image, region, warp.map_x, warp.map_y, cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
+}
+
+void warp_camera(cv::Mat& output_img, const cv::Mat& image, const stitch_model& model, int i, int tr_x, int tr_y) {
+  camera_warp warp;
+
+  create_cylindrical_warp_LUT(warp, model, i, image.size(), output_img.size(), tr_x, tr_y);
+  apply_warp_LUT(output_img, image, warp);
+}
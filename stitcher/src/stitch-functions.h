@@ -0,0 +1,60 @@
+#ifndef STITCH_FUNCTIONS_H
+#define STITCH_FUNCTIONS_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include "../../ocam-undist/src/ocam-functions.h"
+
+struct stitch_model {
+  // Cumulative rotation of every camera around the y axis
+  std::vector<cv::Mat> rotations;
+
+  // Average focal length of every camera type; in this case normal + fisheye
+  std::vector<double> focal_lengths;
+
+  // Omnidirectional models of the cameras (1-based) that have one; the others are treated as pinhole cameras
+  std::map<int, ocam_model> ocam_models;
+
+  // Image centers on the x and y axes
+  double c_x;
+  double c_y;
+
+  // Scaling between the two camera types and the scale of the cylinder
+  double f_scale;
+  double s;
+};
+
+// Region of the output image covered by one camera, and for every pixel of it the point of the camera image it is sampled from
+struct camera_warp {
+  cv::Rect roi;
+  cv::Mat map_x;
+  cv::Mat map_y;
+};
+
+// Reads a rows x cols matrix of doubles from a whitespace separated text file
+cv::Mat read_parameter(const std::string& path, const int& rows = 3, const int& cols = 3);
+
+// Reads the intrinsic and extrinsic camera parameters and derives the rotations and scales used by the cylindrical projection
+// ocamFileNames holds an ocam calibration file for every camera, or an empty string for the pinhole cameras
+void get_stitch_model(stitch_model& model, const std::vector<std::string>& intrinsicFileNames, const std::vector<std::string>& rotationFileNames, const std::vector<std::string>& ocamFileNames, int cameraNumber);
+
+// Size of the output image and the translation that turns the cylindrical projection into a panoramic image
+// tr_x is set so that the first column of the first camera is the first column of the output image
+void get_panorama_layout(const stitch_model& model, const cv::Size& image_size, cv::Size& output_size, int& tr_x, int& tr_y);
+
+// Builds the inverse map of the i-th camera (1-based): the cylindrical projection is composed with the camera model,
+// so every output pixel is sampled from the raw (even fisheye) camera image with a single interpolation
+// image_size and the translations are given in full resolution; with a reduction of k the map is built for
+// an output image and camera images reduced k times, e.g. decoded with cv::IMREAD_REDUCED_COLOR_4
+void create_cylindrical_warp_LUT(camera_warp& warp, const stitch_model& model, int i, const cv::Size& image_size, const cv::Size& output_size, int tr_x, int tr_y, int reduction = 1);
+
+// Samples the camera image into its region of the output image; pixels outside of the camera image are left untouched
+void apply_warp_LUT(cv::Mat& output_img, const cv::Mat& image, const camera_warp& warp);
+
+// Projects the image of the i-th camera onto the cylindrical output image; builds the map and applies it
+void warp_camera(cv::Mat& output_img, const cv::Mat& image, const stitch_model& model, int i, int tr_x, int tr_y);
+
+#endif